@@ -0,0 +1,99 @@
+// Strong and weak scaling of distributed_heat_transfer over local processes.
+//
+//   distributed_scaling [max_ranks] [grid] [steps]
+//
+// Every configuration is first checked against heat_transfer_program on the
+// same grid. Strong scaling keeps grid x grid fixed while adding ranks, weak
+// scaling gives every rank grid x grid cells (the z extent grows).
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "distributed_heat_transfer.hpp"
+#include "local_socket_transport.hpp"
+
+static parameters make_parameters(unsigned r_divisions, unsigned z_divisions)
+{
+    parameters p;
+    p.r_divisions = r_divisions;
+    p.z_divisions = z_divisions;
+    p.height = p.radius * z_divisions / r_divisions;
+    // the explicit half of the scheme needs dt ~ h^2
+    p.t_step = 8e-6 * std::pow(64.0 / std::max(r_divisions,z_divisions),2);
+    return p;
+}
+
+// time per step on rank 0, negative on failure
+static double run(int ranks, const parameters& p, unsigned steps, double* max_error)
+{
+    heat_transfer_program reference;
+    if (max_error)
+    {
+        reference.p = p;
+        reference.p.recording.mode = recording_policy::every_n_steps;
+        reference.p.recording.n_steps = steps;
+        reference.init();
+        for (unsigned k = 0; k < steps; ++k) reference.cycle_function();
+    }
+
+    double seconds_per_step = -1;
+    int code = spawn_local_ranks(ranks,[&](transport& net)
+    {
+        distributed_heat_transfer solver(net,p);
+        solver.init();
+        net.barrier();
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned k = 0; k < steps; ++k) solver.cycle_function();
+        net.barrier();
+        auto stop = std::chrono::steady_clock::now();
+
+        mat field = solver.gather();
+        if (net.rank() == 0)
+        {
+            seconds_per_step = std::chrono::duration<double>(stop - start).count() / steps;
+            if (max_error)
+            {
+                *max_error = 0;
+                for (size_t i = 0; i < field.size1(); ++i)
+                    for (size_t j = 0; j < field.size2(); ++j)
+                        *max_error = std::max(*max_error,std::abs(field(i,j) - reference.v.T(i,j)));
+            }
+        }
+        return 0;
+    });
+    return code == 0 ? seconds_per_step : -1;
+}
+
+int main(int argc, char** argv)
+{
+    int max_ranks  = argc > 1 ? std::atoi(argv[1]) : 4;
+    unsigned grid  = argc > 2 ? std::atoi(argv[2]) : 512;
+    unsigned steps = argc > 3 ? std::atoi(argv[3]) : 20;
+
+    std::printf("strong scaling, %ux%u, %u steps\n",grid,grid,steps);
+    std::printf("%6s %14s %10s %10s %12s\n","ranks","ms/step","speedup","efficiency","max |dT|");
+    double base = 0;
+    for (int ranks = 1; ranks <= max_ranks; ranks *= 2)
+    {
+        double error = 0;
+        double t = run(ranks,make_parameters(grid,grid),steps,&error);
+        if (t < 0) { std::printf("%6d failed\n",ranks); return 1; }
+        if (ranks == 1) base = t;
+        std::printf("%6d %14.3f %10.2f %10.2f %12.3g\n",ranks,t * 1e3,base / t,base / t / ranks,error);
+    }
+
+    std::printf("\nweak scaling, %ux(%u*ranks), %u steps\n",grid,grid,steps);
+    std::printf("%6s %14s %10s %12s\n","ranks","ms/step","efficiency","max |dT|");
+    for (int ranks = 1; ranks <= max_ranks; ranks *= 2)
+    {
+        double error = 0;
+        double t = run(ranks,make_parameters(grid,grid * ranks),steps,&error);
+        if (t < 0) { std::printf("%6d failed\n",ranks); return 1; }
+        if (ranks == 1) base = t;
+        std::printf("%6d %14.3f %10.2f %12.3g\n",ranks,t * 1e3,base / t,error);
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    distributed_scaling.cpp
+
+HEADERS += \
+    ../distributed_heat_transfer.hpp \
+    ../local_socket_transport.hpp \
+    ../transport.hpp
+
+INCLUDEPATH += \
+    .. \
+    C:\libs\boost_1_82_0 \
+    C:\my_lib
+
+unix: LIBS += -pthread
@@ -0,0 +1,262 @@
+// Accuracy and cost of heat_transfer_program against analytic solutions.
+//
+//   validation [max_nodes] [t_end]
+//
+// Every case is a single uniform material (no wall, no heater) started from
+// an exact decaying mode, so the field at t_end is known in closed form:
+//   slab       insulated everywhere, cos(pi z) exp(-pi^2 t)
+//   bessel     insulated everywhere, J0(b1 r) exp(-b1^2 t), J1(b1) = 0
+//   dirichlet  T = 0 on the side and the top (large epsilon),
+//              J0(a1 r) cos(pi z / 2) exp(-(a1^2 + pi^2/4) t), J0(a1) = 0
+// on the unit cylinder. Grids are refined by halving h with dt = c h^2, so
+// the observed order of the space-time refinement is log2 of successive
+// error ratios; c is varied on the finest grid for the time step alone.
+// Every table is made for the second order scheme ("2") and for the compact
+// fourth order one ("4c"). All runs then go into an error vs wall time table
+// where the settings that no other run beats in both are marked as the
+// Pareto front.
+//
+// Last, the slab case runs with activity tracking on and off, and the
+// deviation between the two must stay within the reported error_bound;
+// the exit status is nonzero when it does not.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "heat_transfer_program.hpp"
+
+struct validation_case
+{
+    const char* name;
+    double epsilon;
+    std::function<double(double r, double z, double t)> exact;
+};
+
+struct run_result
+{
+    parameters::difference_scheme scheme;
+    unsigned nodes;
+    double c, dt;
+    unsigned long steps;
+    double max_error, l2_error; // relative to the mode's amplitude at t_end
+    double seconds;
+
+    bool stable() const { return std::isfinite(l2_error) && l2_error < 1; }
+};
+
+static const double pi = 3.14159265358979323846;
+static const double j0_zero = 2.404825557695773;  // first zero of J0
+static const double j1_zero = 3.8317059702075125; // first zero of J1
+
+static std::vector<validation_case> cases()
+{
+    return {
+        {"slab",0.0,[](double, double z, double t)
+            { return std::cos(pi * z) * std::exp(-pi * pi * t); }},
+        {"bessel",0.0,[](double r, double, double t)
+            { return std::cyl_bessel_j(0.0,j1_zero * r) * std::exp(-j1_zero * j1_zero * t); }},
+        {"dirichlet",1e12,[](double r, double z, double t)
+            { return std::cyl_bessel_j(0.0,j0_zero * r) * std::cos(0.5 * pi * z) *
+                     std::exp(-(j0_zero * j0_zero + 0.25 * pi * pi) * t); }},
+    };
+}
+
+static parameters make_parameters(const validation_case& vc, parameters::difference_scheme scheme,
+                                  unsigned nodes, double dt)
+{
+    parameters p;
+    p.scheme = scheme;
+    p.radius = 1;
+    p.height = 1;
+    p.wall_width = 0;
+    p.heater_radius = 0;
+    p.heater_height = 0;
+    p.heater_power = 0;
+    p.external_temperature = 0;
+    p.epsilon = vc.epsilon;
+    p.r_divisions = nodes;
+    p.z_divisions = nodes;
+    p.t_step = dt;
+    p.recording.mode = recording_policy::every_n_steps;
+    p.recording.n_steps = ~0u;
+    p.recording.max_history = 1;
+    return p;
+}
+
+static run_result run(const validation_case& vc, parameters::difference_scheme scheme,
+                      unsigned nodes, double c, double t_end)
+{
+    double h = 1.0 / (nodes - 1);
+    unsigned long steps = std::max(1.0,std::ceil(t_end / (c * h * h)));
+    double dt = t_end / steps;
+
+    heat_transfer_program program;
+    program.p = make_parameters(vc,scheme,nodes,dt);
+    program.init();
+
+    auto& r = program.v.r;
+    auto& z = program.v.z;
+    for (size_t i = 0; i < r.size(); ++i)
+        for (size_t j = 0; j < z.size(); ++j)
+            program.v.T(i,j) = vc.exact(r[i],z[j],0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long k = 0; k < steps; ++k) program.cycle_function();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // control volumes as in the scheme: half a step around every node
+    auto volume = [](const discrete_linspace& x, size_t k, bool radial)
+    {
+        double a = std::max(x[0],x[k] - 0.5 * x.get_step());
+        double b = std::min(x[x.size()-1],x[k] + 0.5 * x.get_step());
+        return radial ? 0.5 * (b*b - a*a) : b - a;
+    };
+
+    double amplitude = 0, max_error = 0, sum = 0, weight = 0;
+    for (size_t i = 0; i < r.size(); ++i)
+        for (size_t j = 0; j < z.size(); ++j)
+        {
+            double exact = vc.exact(r[i],z[j],t_end);
+            double e = program.v.T(i,j) - exact;
+            double w = volume(r,i,true) * volume(z,j,false);
+            amplitude = std::max(amplitude,std::abs(exact));
+            max_error = std::max(max_error,std::abs(e));
+            if (!std::isfinite(e)) max_error = e;
+            sum += w * e * e;
+            weight += w;
+        }
+
+    return {scheme,nodes,c,dt,steps,max_error / amplitude,std::sqrt(sum / weight) / amplitude,seconds};
+}
+
+static const char* scheme_name(parameters::difference_scheme scheme)
+{
+    return scheme == parameters::compact_fourth_order ? "4c" : "2";
+}
+
+// max |T_tracked - T_full| and the tracked run's error_bound after 'steps'
+// steps of dt on the slab case
+static std::pair<double,double> activity_deviation(const validation_case& vc, unsigned nodes, double dt,
+                                                   unsigned long steps, double tolerance)
+{
+    auto final_state = [&](bool tracking)
+    {
+        heat_transfer_program program;
+        program.p = make_parameters(vc,parameters::second_order,nodes,dt);
+        program.p.activity.enabled = tracking;
+        program.p.activity.tolerance = tolerance;
+        program.init();
+        for (size_t i = 0; i < program.v.r.size(); ++i)
+            for (size_t j = 0; j < program.v.z.size(); ++j)
+                program.v.T(i,j) = vc.exact(program.v.r[i],program.v.z[j],0);
+        for (unsigned long k = 0; k < steps; ++k) program.cycle_function();
+        return std::make_pair(program.v.T,program.v.activity.error_bound);
+    };
+
+    auto full = final_state(false), tracked = final_state(true);
+    double deviation = 0;
+    for (size_t k = 0; k < full.first.data().size(); ++k)
+        deviation = std::max(deviation,std::abs(full.first.data()[k] - tracked.first.data()[k]));
+    return {deviation,tracked.second};
+}
+
+static void print_row(const run_result& x, const char* mark = "")
+{
+    std::printf("%6s %6u %8.3f %12.4g %8lu %12.4g %12.4g %10.3f %s\n",
+                scheme_name(x.scheme),x.nodes,x.c,x.dt,x.steps,x.max_error,x.l2_error,x.seconds,x.stable() ? mark : "unstable");
+}
+
+static void print_header()
+{
+    std::printf("%6s %6s %8s %12s %8s %12s %12s %10s\n","scheme","nodes","dt/h^2","dt","steps","max err","L2 err","seconds");
+}
+
+static double order(double coarse, double fine, double ratio)
+{
+    return std::log(coarse / fine) / std::log(ratio);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned max_nodes = argc > 1 ? std::atoi(argv[1]) : 65;
+    double t_end       = argc > 2 ? std::atof(argv[2]) : 0.02;
+
+    std::vector<unsigned> grids;
+    for (unsigned n = 9; n <= max_nodes; n = 2 * n - 1) grids.push_back(n);
+    const std::vector<double> ratios = {3.2,0.8,0.2,0.05};
+    const double refinement_ratio = 0.2;
+    const parameters::difference_scheme schemes[] = {parameters::second_order,parameters::compact_fourth_order};
+
+    for (auto& vc : cases())
+    {
+        std::printf("== %s, t_end = %g\n",vc.name,t_end);
+
+        std::vector<run_result> all;
+        for (auto scheme : schemes)
+            for (unsigned n : grids)
+                for (double c : ratios)
+                    all.push_back(run(vc,scheme,n,c,t_end));
+
+        auto find = [&](parameters::difference_scheme scheme, unsigned n, double c) -> const run_result&
+        {
+            return *std::find_if(all.begin(),all.end(),[&](const run_result& x)
+                                 { return x.scheme == scheme && x.nodes == n && x.c == c; });
+        };
+
+        for (auto scheme : schemes)
+        {
+            std::printf("\nspace-time refinement, scheme %s, dt = %g h^2\n",scheme_name(scheme),refinement_ratio);
+            print_header();
+            for (size_t k = 0; k < grids.size(); ++k)
+            {
+                auto& x = find(scheme,grids[k],refinement_ratio);
+                if (k == 0 || !x.stable()) { print_row(x); continue; }
+                auto& prev = find(scheme,grids[k-1],refinement_ratio);
+                std::printf("%6s %6u %8.3f %12.4g %8lu %12.4g %12.4g %10.3f  order %.2f (max) %.2f (L2)\n",
+                            scheme_name(scheme),x.nodes,x.c,x.dt,x.steps,x.max_error,x.l2_error,x.seconds,
+                            order(prev.max_error,x.max_error,2),order(prev.l2_error,x.l2_error,2));
+            }
+
+            std::printf("\ntime step refinement, scheme %s, on %u nodes\n",scheme_name(scheme),grids.back());
+            print_header();
+            for (size_t k = 0; k < ratios.size(); ++k)
+            {
+                auto& x = find(scheme,grids.back(),ratios[k]);
+                if (k == 0 || !x.stable()) { print_row(x); continue; }
+                auto& prev = find(scheme,grids.back(),ratios[k-1]);
+                std::printf("%6s %6u %8.3f %12.4g %8lu %12.4g %12.4g %10.3f  order %.2f (L2)\n",
+                            scheme_name(scheme),x.nodes,x.c,x.dt,x.steps,x.max_error,x.l2_error,x.seconds,
+                            order(prev.l2_error,x.l2_error,prev.dt / x.dt));
+            }
+        }
+
+        // a run is on the front when no other run is both faster and more accurate
+        std::sort(all.begin(),all.end(),[](const run_result& a, const run_result& b){ return a.seconds < b.seconds; });
+        std::printf("\nL2 error vs wall time, * - Pareto front\n");
+        print_header();
+        double best = INFINITY;
+        for (auto& x : all)
+        {
+            bool front = x.stable() && x.l2_error < best;
+            if (front) best = x.l2_error;
+            print_row(x,front ? "*" : "");
+        }
+        std::printf("\n");
+    }
+    std::printf("== activity tracking, slab, 33 nodes, dt = 1e-5, 2000 steps\n");
+    std::printf("%10s %12s %12s\n","tolerance","deviation","error_bound");
+    bool bounded = true;
+    for (double tolerance : {1e-3,1e-4,1e-5})
+    {
+        auto [deviation, bound] = activity_deviation(cases()[0],33,1e-5,2000,tolerance);
+        bool ok = deviation <= bound;
+        bounded = bounded && ok;
+        std::printf("%10g %12.4g %12.4g %s\n",tolerance,deviation,bound,ok ? "" : "EXCEEDED");
+    }
+    return bounded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
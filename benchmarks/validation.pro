@@ -0,0 +1,16 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    validation.cpp
+
+HEADERS += \
+    ../heat_transfer_program.hpp
+
+INCLUDEPATH += \
+    .. \
+    C:\libs\boost_1_82_0 \
+    C:\my_lib
+
+unix: LIBS += -pthread
@@ -0,0 +1,244 @@
+#include "heat_transfer_c.h"
+#include "heat_transfer_program.hpp"
+
+#include <climits>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string>
+
+struct ht_solver
+{
+    heat_transfer_program program;
+    parameters staged;      // what ht_set_parameter wrote, applied by ht_reset / ht_step
+    bool dirty = false;
+    bool initialized = false;
+    std::string error;
+};
+
+namespace
+{
+    struct parameter_access
+    {
+        std::function<double(const parameters&)> get;
+        std::function<bool(parameters&, double)> set; // false on a bad value
+    };
+
+    // grids beyond this many nodes per side are rejected up front
+    constexpr double max_divisions = 1 << 16;
+
+    // values outside [min,max] or not representable in T are rejected
+    template <typename T>
+    parameter_access field(T parameters::* member, double min = -INFINITY, double max = INFINITY)
+    {
+        if (std::numeric_limits<T>::is_integer) max = std::min(max,double(std::numeric_limits<T>::max()));
+        return {
+            [member](const parameters& p){ return double(p.*member); },
+            [member,min,max](parameters& p, double v){ if (!(v >= min && v <= max)) return false; p.*member = T(v); return true; }
+        };
+    }
+
+    parameter_access material_field(parameters::material parameters::* m, bool conductivity)
+    {
+        return {
+            [m,conductivity](const parameters& p)
+            { return conductivity ? (p.*m).thermal_conductivity : (p.*m).thermal_capacity; },
+            [m,conductivity](parameters& p, double v)
+            {
+                if (!(v > 0)) return false;
+                auto& old = p.*m;
+                p.*m = conductivity ? parameters::material(v,old.thermal_capacity)
+                                    : parameters::material(old.thermal_conductivity,v);
+                return true;
+            }
+        };
+    }
+
+    const std::map<std::string,parameter_access>& parameter_table()
+    {
+        static const std::map<std::string,parameter_access> table = {
+            {"height",               field(&parameters::height,0)},
+            {"radius",               field(&parameters::radius,0)},
+            {"wall_width",           field(&parameters::wall_width,0)},
+            {"heater_height",        field(&parameters::heater_height,0)},
+            {"heater_radius",        field(&parameters::heater_radius,0)},
+            {"heater_power",         field(&parameters::heater_power)},
+            {"external_temperature", field(&parameters::external_temperature)},
+            {"epsilon",              field(&parameters::epsilon,0)},
+            {"r_divisions",          field(&parameters::r_divisions,3,max_divisions)},
+            {"z_divisions",          field(&parameters::z_divisions,3,max_divisions)},
+            {"t_step",               field(&parameters::t_step,0)},
+            {"t0",                   field(&parameters::t0,0)},
+            {"z0",                   field(&parameters::z0,0)},
+            {"T0",                   field(&parameters::T0,0)},
+            {"liquid.conductivity",  material_field(&parameters::liquid,true)},
+            {"liquid.capacity",      material_field(&parameters::liquid,false)},
+            {"metal.conductivity",   material_field(&parameters::metal,true)},
+            {"metal.capacity",       material_field(&parameters::metal,false)},
+            {"activity.enabled",
+                {[](const parameters& p){ return p.activity.enabled ? 1.0 : 0.0; },
+                 [](parameters& p, double v){ p.activity.enabled = v != 0; return true; }}},
+            {"activity.tolerance",
+                {[](const parameters& p){ return p.activity.tolerance; },
+                 [](parameters& p, double v){ if (!(v >= 0)) return false; p.activity.tolerance = v; return true; }}},
+            {"activity.recheck_every",
+                {[](const parameters& p){ return double(p.activity.recheck_every); },
+                 [](parameters& p, double v){ if (!(v >= 1 && v <= UINT_MAX)) return false; p.activity.recheck_every = unsigned(v); return true; }}},
+            {"scheme",
+                {[](const parameters& p){ return double(p.scheme); },
+                 [](parameters& p, double v)
+                 {
+                     if (v != parameters::second_order && v != parameters::compact_fourth_order) return false;
+                     p.scheme = parameters::difference_scheme(int(v));
+                     return true;
+                 }}},
+        };
+        return table;
+    }
+
+    // runs f, turning exceptions into a status and a message on the solver
+    template <typename F>
+    int guarded(ht_solver* s, F f)
+    {
+        try
+        {
+            s->error.clear();
+            return f();
+        }
+        catch (const std::exception& e) { s->error = e.what(); }
+        catch (...) { s->error = "unknown exception"; }
+        return HT_ERROR_EXCEPTION;
+    }
+
+    int fail(ht_solver* s, int status, std::string message)
+    {
+        s->error = std::move(message);
+        return status;
+    }
+}
+
+extern "C" {
+
+unsigned ht_api_version(void)
+{
+    return HT_API_VERSION;
+}
+
+ht_solver* ht_create(void)
+{
+    try
+    {
+        auto s = new ht_solver;
+        // no history: frames would be copies nobody reads
+        s->staged.recording.mode = recording_policy::every_n_steps;
+        s->staged.recording.n_steps = UINT_MAX;
+        s->staged.recording.max_history = 1;
+        s->program.p = s->staged;
+        return s;
+    }
+    catch (...) { return nullptr; }
+}
+
+void ht_destroy(ht_solver* solver)
+{
+    delete solver;
+}
+
+int ht_set_parameter(ht_solver* solver, const char* name, double value)
+{
+    if (!solver || !name) return HT_ERROR_ARGUMENT;
+    return guarded(solver,[&]
+    {
+        auto& table = parameter_table();
+        auto it = table.find(name);
+        if (it == table.end()) return fail(solver,HT_ERROR_UNKNOWN_PARAMETER,std::string("unknown parameter ") + name);
+        if (!it->second.set(solver->staged,value)) return fail(solver,HT_ERROR_ARGUMENT,std::string("bad value for ") + name);
+        solver->dirty = true;
+        return int(HT_OK);
+    });
+}
+
+int ht_get_parameter(const ht_solver* solver, const char* name, double* value)
+{
+    if (!solver || !name || !value) return HT_ERROR_ARGUMENT;
+    auto& table = parameter_table();
+    auto it = table.find(name);
+    if (it == table.end()) return HT_ERROR_UNKNOWN_PARAMETER;
+    *value = it->second.get(solver->staged);
+    return HT_OK;
+}
+
+int ht_reset(ht_solver* solver)
+{
+    if (!solver) return HT_ERROR_ARGUMENT;
+    return guarded(solver,[&]
+    {
+        const parameters applied = solver->program.p;
+        try
+        {
+            solver->program.p = solver->staged;
+            solver->program.init();
+        }
+        catch (...)
+        {
+            // the field is half built; drop the staged change and require
+            // another ht_reset
+            solver->program.p = applied;
+            solver->staged = applied;
+            solver->dirty = false;
+            solver->initialized = false;
+            throw;
+        }
+        solver->dirty = false;
+        solver->initialized = true;
+        return int(HT_OK);
+    });
+}
+
+int ht_step(ht_solver* solver, unsigned long long steps)
+{
+    if (!solver) return HT_ERROR_ARGUMENT;
+    if (!solver->initialized) return fail(solver,HT_ERROR_NOT_INITIALIZED,"ht_reset was not called");
+    return guarded(solver,[&]
+    {
+        auto& program = solver->program;
+        if (solver->dirty)
+        {
+            // a change that cannot be applied is dropped, the program keeps
+            // its state (apply_parameters leaves it untouched on failure)
+            solver->dirty = false;
+            try { program.apply_parameters(solver->staged); }
+            catch (...) { solver->staged = program.p; throw; }
+        }
+        for (unsigned long long k = 0; k < steps; ++k) program.cycle_function();
+        return int(HT_OK);
+    });
+}
+
+int ht_field(const ht_solver* solver, ht_field_view* out)
+{
+    if (!solver || !out) return HT_ERROR_ARGUMENT;
+    if (!solver->initialized) return HT_ERROR_NOT_INITIALIZED;
+
+    auto& v = solver->program.v;
+    out->T = &v.T.data()[0];
+    out->nr = v.T.size1();
+    out->nz = v.T.size2();
+    out->row_stride = v.T.size2();
+    out->r_first = v.r[0];
+    out->r_step = v.r.get_step();
+    out->z_first = v.z[0];
+    out->z_step = v.z.get_step();
+    out->t = v.t;
+    out->step = v.step;
+    return HT_OK;
+}
+
+const char* ht_last_error(const ht_solver* solver)
+{
+    return solver ? solver->error.c_str() : "null solver";
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef HEAT_TRANSFER_C_H
+#define HEAT_TRANSFER_C_H
+
+/*
+ * C interface to heat_transfer_program for driving runs in-process.
+ *
+ *   ht_solver* s = ht_create();
+ *   ht_set_parameter(s,"r_divisions",128);
+ *   ht_reset(s);                         // field at external_temperature
+ *   ht_step(s,10000);
+ *   ht_field_view f; ht_field(s,&f);     // borrowed, no copy
+ *   ...
+ *   ht_destroy(s);
+ *
+ * Parameters are in the solver's units (lengths scaled by z0, as the
+ * program stores them). Changes made after ht_reset are applied in place
+ * by the next ht_step, keeping the field; a new grid receives the field
+ * remapped. A change that fails to apply is dropped: the solver keeps its
+ * previous parameters and field (after a failed ht_reset, ht_reset must be
+ * called again). Frames are not recorded.
+ *
+ * Functions return HT_OK or a negative status; ht_last_error tells more.
+ * Different solvers may be used from different threads at once, one
+ * solver from one thread at a time.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#  if defined(HEAT_TRANSFER_C_BUILD)
+#    define HT_API __declspec(dllexport)
+#  else
+#    define HT_API __declspec(dllimport)
+#  endif
+#else
+#  define HT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HT_API_VERSION 1
+
+enum ht_status
+{
+    HT_OK = 0,
+    HT_ERROR_ARGUMENT = -1,          /* null solver, bad value */
+    HT_ERROR_UNKNOWN_PARAMETER = -2,
+    HT_ERROR_NOT_INITIALIZED = -3,   /* ht_reset was not called */
+    HT_ERROR_EXCEPTION = -4          /* the solver failed */
+};
+
+typedef struct ht_solver ht_solver;
+
+/* The current field, T(i,j) at T[i*row_stride + j]; r_i = r_first + i*r_step,
+ * z_j = z_first + j*z_step. T stays valid until the next call that changes
+ * the solver (ht_step, ht_reset, ht_destroy). */
+typedef struct ht_field_view
+{
+    const double* T;
+    size_t nr, nz;
+    size_t row_stride;
+    double r_first, r_step;
+    double z_first, z_step;
+    double t;
+    unsigned long long step;
+} ht_field_view;
+
+HT_API unsigned ht_api_version(void);
+
+HT_API ht_solver* ht_create(void);
+HT_API void ht_destroy(ht_solver* solver);
+
+/* values out of range (r_divisions and z_divisions in [3,65536]) give
+ * HT_ERROR_ARGUMENT.
+ * names: height, radius, wall_width, heater_height, heater_radius,
+ * heater_power, external_temperature, epsilon, r_divisions, z_divisions,
+ * t_step, t0, z0, T0, liquid.conductivity, liquid.capacity,
+ * metal.conductivity, metal.capacity, activity.enabled,
+ * activity.tolerance, activity.recheck_every,
+ * scheme (0 - second order, 1 - compact fourth order) */
+HT_API int ht_set_parameter(ht_solver* solver, const char* name, double value);
+HT_API int ht_get_parameter(const ht_solver* solver, const char* name, double* value);
+
+HT_API int ht_reset(ht_solver* solver);
+HT_API int ht_step(ht_solver* solver, unsigned long long steps);
+HT_API int ht_field(const ht_solver* solver, ht_field_view* out);
+
+/* message of the last failure on this solver, "" if none */
+HT_API const char* ht_last_error(const ht_solver* solver);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEAT_TRANSFER_C_H */
@@ -0,0 +1,21 @@
+TEMPLATE = lib
+TARGET = heat_transfer_c
+CONFIG += shared c++17
+CONFIG -= qt
+
+DEFINES += HEAT_TRANSFER_C_BUILD
+
+SOURCES += \
+    heat_transfer_c.cpp
+
+HEADERS += \
+    heat_transfer_c.h \
+    ../heat_transfer_program.hpp
+
+INCLUDEPATH += \
+    .. \
+    C:\libs\boost_1_82_0 \
+    C:\my_lib
+
+unix: QMAKE_CXXFLAGS += -fvisibility=hidden
+unix: LIBS += -pthread
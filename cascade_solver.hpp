@@ -0,0 +1,174 @@
+#ifndef CASCADE_SOLVER_HPP
+#define CASCADE_SOLVER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "heat_transfer_program.hpp"
+
+// Coarse-to-fine start for fine grids. The program is run on a grid with
+// about half the divisions of the next level until the residual
+// max|dT|/dt falls below the tolerance, then the field is interpolated onto
+// the finer grid and the next level runs, up to the target r_divisions and
+// z_divisions in program.p. The program is left on the target grid, ready
+// to continue from the near-converged field; time and step count carry on
+// through the levels.
+class cascade_solver
+{
+public:
+    struct settings
+    {
+        unsigned max_levels{6};      // coarse levels below the target
+        unsigned min_divisions{16};  // no level gets fewer along r or z
+        double tolerance{1.0};       // residual max|dT|/dt to leave a level at
+        unsigned long max_steps_per_level{200000};
+        unsigned check_every{10};    // steps between residual checks
+        bool scale_time_step{true};  // dt ~ h^2 on the coarse levels
+    };
+
+    struct level_report
+    {
+        unsigned r_divisions, z_divisions;
+        double t_step;
+        unsigned long steps;
+        double residual;
+        double seconds;
+        bool converged;
+    };
+
+    explicit cascade_solver(heat_transfer_program& program) : program(program) {}
+    cascade_solver(heat_transfer_program& program, settings s) : program(program), s(s) {}
+
+    std::atomic<bool> cancel{false};
+
+    // Runs the coarse levels; the last report is the target grid right
+    // after the final interpolation (no steps taken on it).
+    std::vector<level_report> run()
+    {
+        typedef std::chrono::steady_clock clock;
+        const parameters target = program.p;
+        auto chain = divisions(target.r_divisions,target.z_divisions);
+
+        std::vector<level_report> reports;
+        for (size_t level = 0; level < chain.size(); ++level)
+        {
+            auto start = clock::now();
+
+            parameters lp = target;
+            lp.r_divisions = chain[level].first;
+            lp.z_divisions = chain[level].second;
+            if (s.scale_time_step)
+            {
+                double ratio = std::min(double(target.r_divisions - 1) / (lp.r_divisions - 1),
+                                        double(target.z_divisions - 1) / (lp.z_divisions - 1));
+                lp.t_step = target.t_step * ratio * ratio;
+            }
+            if (level + 1 == chain.size()) lp = target;
+
+            if (level == 0) program.apply_parameters(lp); // restricts the current field
+            else            enter_finer(lp);
+
+            level_report report{lp.r_divisions,lp.z_divisions,lp.t_step,0,
+                                std::numeric_limits<double>::quiet_NaN(),0,false};
+
+            if (level + 1 < chain.size())
+            {
+                mat before;
+                unsigned check = std::max(1u,s.check_every);
+                while (report.steps < s.max_steps_per_level && !cancel)
+                {
+                    bool checking = (report.steps + 1) % check == 0;
+                    if (checking) before = program.v.T;
+                    program.cycle_function();
+                    report.steps++;
+                    if (!checking) continue;
+
+                    report.residual = max_change(before,program.v.T) / program.p.t_step;
+                    if (report.residual < s.tolerance) { report.converged = true; break; }
+                }
+            }
+
+            report.seconds = std::chrono::duration<double>(clock::now() - start).count();
+            reports.push_back(report);
+            if (cancel) break;
+        }
+        return reports;
+    }
+
+    // grid sizes from the coarsest level to the target
+    std::vector<std::pair<unsigned,unsigned>> divisions(unsigned nr, unsigned nz) const
+    {
+        std::vector<std::pair<unsigned,unsigned>> chain{{nr,nz}};
+        for (unsigned k = 0; k < s.max_levels; ++k)
+        {
+            // node counts include both ends, so n nodes halve to (n+1)/2
+            unsigned cr = (chain.back().first + 1) / 2, cz = (chain.back().second + 1) / 2;
+            if (std::min(cr,cz) < std::max(3u,s.min_divisions)) break;
+            chain.emplace_back(cr,cz);
+        }
+        std::reverse(chain.begin(),chain.end());
+        return chain;
+    }
+
+    // bilinear interpolation of T from (r,z) onto (new_r,new_z)
+    static mat prolongate(const mat& T,
+                          const discrete_linspace& r, const discrete_linspace& z,
+                          const discrete_linspace& new_r, const discrete_linspace& new_z)
+    {
+        auto locate = [](const discrete_linspace& x, double at, size_t& k, double& f)
+        {
+            double u = std::clamp((at - x[0]) / x.get_step(),0.0,double(x.size() - 1));
+            k = std::min<size_t>(u,x.size() - 2);
+            f = u - k;
+        };
+
+        std::vector<size_t> zk(new_z.size());
+        std::vector<double> zf(new_z.size());
+        for (size_t j = 0; j < new_z.size(); ++j) locate(z,new_z[j],zk[j],zf[j]);
+
+        mat result(new_r.size(),new_z.size());
+        for (size_t i = 0; i < new_r.size(); ++i)
+        {
+            size_t a; double fr;
+            locate(r,new_r[i],a,fr);
+            for (size_t j = 0; j < new_z.size(); ++j)
+            {
+                size_t b = zk[j]; double fz = zf[j];
+                result(i,j) = (1-fr) * ((1-fz) * T(a,b)   + fz * T(a,b+1))
+                            +    fr  * ((1-fz) * T(a+1,b) + fz * T(a+1,b+1));
+            }
+        }
+        return result;
+    }
+
+    static double max_change(const mat& a, const mat& b)
+    {
+        double m = 0;
+        auto x = a.data().begin(), y = b.data().begin();
+        for (; x != a.data().end(); ++x, ++y) m = std::max(m,std::abs(*x - *y));
+        return m;
+    }
+
+private:
+    void enter_finer(const parameters& lp)
+    {
+        auto r = program.v.r, z = program.v.z;
+        mat coarse = std::move(program.v.T);
+
+        program.p = lp;
+        program.init_geometry();
+        program.v.T = prolongate(coarse,r,z,program.v.r,program.v.z);
+        program.reset_balance();
+        program.record_frame();
+    }
+
+    heat_transfer_program& program;
+    settings s;
+};
+
+#endif // CASCADE_SOLVER_HPP
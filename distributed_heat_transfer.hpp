@@ -0,0 +1,258 @@
+#ifndef DISTRIBUTED_HEAT_TRANSFER_HPP
+#define DISTRIBUTED_HEAT_TRANSFER_HPP
+
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "heat_transfer_program.hpp"
+#include "transport.hpp"
+
+// heat_transfer_program split over the ranks of a transport.
+//
+// Between steps every rank holds a slab of z columns (plus two halo columns
+// on each side) over all r rows, so the r-sweep is local. The field is then
+// transposed into slabs of r rows (plus two halo rows) for the z-sweep and
+// transposed back. The forward transpose is cut into chunks of rows and
+// pipelined: while chunk c is swept along z, chunk c+1 is in flight.
+// The halos ride along with the transposes, no separate exchange is needed.
+// Only the full second order scheme is distributed; parameters asking for
+// the compact one or for activity tracking are rejected by the constructor.
+class distributed_heat_transfer
+{
+public:
+    distributed_heat_transfer(transport& net, const parameters& prm, unsigned pipeline_chunks = 4)
+        : net(net), chunks(std::max(1u,pipeline_chunks))
+    {
+        if (prm.scheme != parameters::second_order)
+            throw std::runtime_error("distributed_heat_transfer: only the second order scheme is supported");
+        if (prm.activity.enabled)
+            throw std::runtime_error("distributed_heat_transfer: activity tracking is not supported");
+        program.p = prm;
+        program.init_geometry();
+    }
+
+    // uniform external temperature, as heat_transfer_program::init()
+    void init()
+    {
+        auto zh = z_halo(net.rank());
+        Tz = mat(nr(),zh.e - zh.b,program.p.external_temperature);
+        program.v.t = 0;
+        program.v.step = 0;
+    }
+
+    // takes this rank's part of a full field
+    void scatter(const mat& full)
+    {
+        auto zh = z_halo(net.rank());
+        Tz.resize(nr(),zh.e - zh.b,false);
+        for (size_t i = 0; i < nr(); ++i)
+            for (size_t j = zh.b; j < zh.e; ++j)
+                Tz(i,j - zh.b) = full(i,j);
+    }
+
+    // full field on root, an empty matrix on the other ranks
+    mat gather(int root = 0)
+    {
+        int me = net.rank();
+        auto zo = z_own(me);
+        auto zh = z_halo(me);
+
+        if (me != root)
+        {
+            std::vector<double> block = pack(Tz,0,nr(),zo.b - zh.b,zo.e - zh.b);
+            net.send(root,block.data(),block.size() * sizeof(double));
+            return mat();
+        }
+
+        mat full(nr(),nz());
+        for (int q = 0; q < net.size(); ++q)
+        {
+            auto zq = z_own(q);
+            std::vector<double> block(nr() * (zq.e - zq.b));
+            if (q == me) block = pack(Tz,0,nr(),zq.b - zh.b,zq.e - zh.b);
+            else net.recv(q,block.data(),block.size() * sizeof(double));
+            unpack(full,block,0,nr(),zq.b,zq.e);
+        }
+        return full;
+    }
+
+    void cycle_function()
+    {
+        const int me = net.rank();
+        const int ranks = net.size();
+        const auto zh = z_halo(me), zo = z_own(me);
+        const auto rh = r_halo(me), ro = r_own(me);
+        const auto b = program.borders();
+        const auto steel_to_water = program.steel_to_water();
+        const auto faces = program.heater_faces();
+        const unsigned r_i = faces.first, z_j = faces.second;
+        const bool interface = program.heater_faces_inside();
+
+        // explicit side and r-sweep on the own columns
+        mat L(Tz.size1(),Tz.size2());
+        program.explicit_operator(Tz,1.0,2.0,L,0,zh.b,0,nr(),zo.b - zh.b,zo.e - zh.b);
+
+        mat Ts(nr(),zo.e - zo.b);
+        run_through_method<double> by_r;
+        for (size_t j = zo.b; j < zo.e; ++j)
+        {
+            size_t jl = j - zh.b;
+            program.solve_r_line(by_r,b,j,
+                                 [&](unsigned i){ return Tz(i,jl); },
+                                 [&](unsigned i){ return L(i,jl); });
+            std::copy(by_r.output.begin(),by_r.output.end(),(Ts.begin2() + (j - zo.b)).begin());
+        }
+
+        // rows [rows_from(q,c), rows_to(q,c)) of rank q arrive with chunk c;
+        // chunk c is complete once they are in
+        auto chunk = [&](int q, unsigned c) { return split(r_own(q),chunks,c); };
+        auto rows_from = [&](int q, unsigned c) {
+            auto h = r_halo(q);
+            return c == 0 ? h.b : std::min(h.e,chunk(q,c-1).e + 2);
+        };
+        auto rows_to = [&](int q, unsigned c) { return std::min(r_halo(q).e,chunk(q,c).e + 2); };
+
+        Tr.resize(rh.e - rh.b,nz(),false);
+        mat Lr(Tr.size1(),Tr.size2());
+        mat Tn(ro.e - ro.b,nz());
+
+        auto exchange = [&](unsigned c)
+        {
+            std::vector<std::vector<double>> send(ranks), recv(ranks);
+            for (int q = 0; q < ranks; ++q)
+            {
+                send[q] = pack(Ts,rows_from(q,c),rows_to(q,c),0,zo.e - zo.b);
+                auto zq = z_own(q);
+                recv[q].resize((rows_to(me,c) - rows_from(me,c)) * (zq.e - zq.b));
+            }
+            net.all_to_all(send,recv);
+            for (int q = 0; q < ranks; ++q)
+            {
+                auto zq = z_own(q);
+                unpack(Tr,recv[q],rows_from(me,c) - rh.b,rows_to(me,c) - rh.b,zq.b,zq.e);
+            }
+        };
+
+        run_through_method<double> by_z;
+        auto sweep = [&](unsigned c)
+        {
+            auto rows = chunk(me,c);
+            if (rows.b == rows.e) return;
+            program.explicit_operator(Tr,1.0,0.5,Lr,rh.b,0,rows.b - rh.b,rows.e - rh.b,0,nz());
+
+            for (size_t i = rows.b; i < rows.e; ++i)
+            {
+                size_t il = i - rh.b;
+                auto out = (Tn.begin1() + (i - ro.b)).begin();
+                if (i == 0) // the axis row keeps its r-sweep value, as in cycle_function()
+                {
+                    std::copy((Tr.begin1() + il).begin(),(Tr.begin1() + il).end(),out);
+                    continue;
+                }
+                program.solve_z_line(by_z,b,i,
+                                     [&](unsigned j){ return Tr(il,j); },
+                                     [&](unsigned j){ return Lr(il,j); });
+                std::copy(by_z.output.begin(),by_z.output.end(),out);
+            }
+
+            for (size_t i = rows.b; interface && i < std::min<size_t>(rows.e,r_i); ++i)
+            {
+                size_t il = i - ro.b;
+                Tn(il,z_j) = steel_to_water(Tn(il,z_j+1),Tn(il,z_j-1));
+            }
+        };
+
+        auto in_flight = std::async(std::launch::async,exchange,0u);
+        for (unsigned c = 0; c < chunks; ++c)
+        {
+            in_flight.get();
+            if (c + 1 < chunks) in_flight = std::async(std::launch::async,exchange,c + 1);
+            sweep(c);
+        }
+
+        // back to z-slabs, halo columns included
+        {
+            std::vector<std::vector<double>> send(ranks), recv(ranks);
+            for (int q = 0; q < ranks; ++q)
+            {
+                auto zq = z_halo(q);
+                send[q] = pack(Tn,0,ro.e - ro.b,zq.b,zq.e);
+                auto rq = r_own(q);
+                recv[q].resize((rq.e - rq.b) * (zh.e - zh.b));
+            }
+            net.all_to_all(send,recv);
+            for (int q = 0; q < ranks; ++q)
+            {
+                auto rq = r_own(q);
+                unpack(Tz,recv[q],rq.b,rq.e,0,zh.e - zh.b);
+            }
+        }
+
+        for (size_t j = zh.b; interface && j < std::min<size_t>(zh.e,z_j); ++j)
+        {
+            size_t jl = j - zh.b;
+            Tz(r_i,jl) = steel_to_water(Tz(r_i-1,jl),Tz(r_i+1,jl));
+        }
+
+        program.v.t += program.p.t_step;
+        program.v.step++;
+    }
+
+    double t() const { return program.v.t; }
+    size_t nr() const { return program.v.r.size(); }
+    size_t nz() const { return program.v.z.size(); }
+
+    // grids, parameters and coefficient functions; v.T stays empty
+    heat_transfer_program program;
+
+private:
+    struct range { size_t b, e; };
+
+    static range split(range whole, unsigned parts, unsigned k)
+    {
+        size_t n = whole.e - whole.b;
+        return {whole.b + n * k / parts,whole.b + n * (k + 1) / parts};
+    }
+
+    range z_own(int q) const { return split({0,nz()},net.size(),q); }
+    range r_own(int q) const { return split({0,nr()},net.size(),q); }
+
+    range z_halo(int q) const
+    {
+        auto o = z_own(q);
+        return {o.b >= 2 ? o.b - 2 : 0,std::min(nz(),o.e + 2)};
+    }
+    range r_halo(int q) const
+    {
+        auto o = r_own(q);
+        return {o.b >= 2 ? o.b - 2 : 0,std::min(nr(),o.e + 2)};
+    }
+
+    // rows [rb,re) x columns [cb,ce) of m, row by row
+    static std::vector<double> pack(const mat& m, size_t rb, size_t re, size_t cb, size_t ce)
+    {
+        std::vector<double> out;
+        out.reserve((re - rb) * (ce - cb));
+        for (size_t i = rb; i < re; ++i)
+            for (size_t j = cb; j < ce; ++j)
+                out.push_back(m(i,j));
+        return out;
+    }
+
+    static void unpack(mat& m, const std::vector<double>& in, size_t rb, size_t re, size_t cb, size_t ce)
+    {
+        auto it = in.begin();
+        for (size_t i = rb; i < re; ++i)
+            for (size_t j = cb; j < ce; ++j)
+                m(i,j) = *it++;
+    }
+
+    transport& net;
+    unsigned chunks;
+
+    mat Tz; // all rows, own columns with halo
+    mat Tr; // own rows with halo, all columns
+};
+
+#endif // DISTRIBUTED_HEAT_TRANSFER_HPP
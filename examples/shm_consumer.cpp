@@ -0,0 +1,58 @@
+// Follows the frames a running heat_transfer publishes into shared memory.
+//
+//   shm_consumer [segment] [seconds]
+//
+// Polls the segment (default "/heat_transfer", the program takes the name
+// from HEAT_TRANSFER_SHM) ten times a second and prints time, step, grid
+// and the temperature range of every new frame, computed in place.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "shm_frame_reader.hpp"
+
+int main(int argc, char** argv)
+{
+    const char* name = argc > 1 ? argv[1] : "/heat_transfer";
+    double seconds   = argc > 2 ? std::atof(argv[2]) : 10;
+
+    shm_frame_reader reader(name);
+    uint64_t last = ~uint64_t(0);
+
+    auto stop = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < stop)
+    {
+        double T_min = 0, T_max = 0, T_mean = 0;
+        shm_frame_reader::frame_view seen{};
+
+        bool fresh = reader.read_latest([&](const shm_frame_reader::frame_view& f)
+        {
+            seen = f;
+            if (f.number == last) return;
+            size_t n = size_t(f.nr) * f.nz;
+            auto range = std::minmax_element(f.T,f.T + n);
+            T_min = *range.first;
+            T_max = *range.second;
+            double sum = 0;
+            for (size_t k = 0; k < n; ++k) sum += f.T[k];
+            T_mean = sum / n;
+        });
+
+        if (fresh && seen.number != last)
+        {
+            last = seen.number;
+            std::printf("frame %llu  t %.6g  step %llu  %ux%u  T %.6g..%.6g  mean %.6g\n",
+                        (unsigned long long)seen.number,seen.t,(unsigned long long)seen.step,
+                        seen.nr,seen.nz,T_min,T_max,T_mean);
+            std::fflush(stdout);
+        }
+        else if (!reader.open())
+            std::printf("waiting for %s\n",name);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+SOURCES += \
+    shm_consumer.cpp
+
+HEADERS += \
+    ../shm_frame_layout.hpp \
+    ../shm_frame_reader.hpp
+
+INCLUDEPATH += \
+    ..
+
+unix: LIBS += -lrt
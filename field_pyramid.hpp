@@ -0,0 +1,81 @@
+#ifndef FIELD_PYRAMID_HPP
+#define FIELD_PYRAMID_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/numeric/ublas/matrix.hpp>
+
+// Min, max and mean of a field over 2x2 blocks, repeated until the field is
+// a single cell. Cell (i,j) of level k covers the source cells
+// [i*2^k, (i+1)*2^k) x [j*2^k, (j+1)*2^k), clipped to the field; level 0 is
+// the field itself and is not stored here.
+class field_pyramid
+{
+public:
+    typedef boost::numeric::ublas::matrix<double> mat;
+
+    struct level
+    {
+        mat min, max, mean;
+    };
+
+    explicit field_pyramid(const mat& T) : rows(T.size1()), cols(T.size2())
+    {
+        if (rows == 0 || cols == 0) return;
+
+        const mat* min = &T, *max = &T, *mean = &T;
+        for (size_t k = 1; min->size1() > 1 || min->size2() > 1; ++k)
+        {
+            levels.push_back(reduce(*min,*max,*mean,k));
+            min = &levels.back().min; max = &levels.back().max; mean = &levels.back().mean;
+        }
+    }
+
+    // number of levels including the field itself
+    size_t size() const { return levels.size() + 1; }
+
+    // k >= 1
+    const level& operator[](size_t k) const { return levels[k-1]; }
+
+    // range of the whole field
+    double min() const { return levels.empty() ? 0 : levels.back().min(0,0); }
+    double max() const { return levels.empty() ? 0 : levels.back().max(0,0); }
+
+private:
+    // level k from level k-1; the mean is weighted by the number of source
+    // cells every block covers, which differs on the last row and column
+    level reduce(const mat& min, const mat& max, const mat& mean, size_t k) const
+    {
+        const size_t n1 = min.size1(), n2 = min.size2();
+        const size_t m1 = (n1 + 1) / 2, m2 = (n2 + 1) / 2;
+        const size_t span = size_t(1) << (k - 1); // source cells per parent cell
+
+        auto cover = [span](size_t index, size_t total) { return double(std::min(span,total - index * span)); };
+
+        level l{mat(m1,m2),mat(m1,m2),mat(m1,m2)};
+        for (size_t i = 0; i < m1; ++i)
+            for (size_t j = 0; j < m2; ++j)
+            {
+                double lo = min(2*i,2*j), hi = max(2*i,2*j), sum = 0, weight = 0;
+                for (size_t a = 2*i; a < std::min(2*i + 2,n1); ++a)
+                    for (size_t b = 2*j; b < std::min(2*j + 2,n2); ++b)
+                    {
+                        lo = std::min(lo,min(a,b));
+                        hi = std::max(hi,max(a,b));
+                        double w = cover(a,rows) * cover(b,cols);
+                        sum += w * mean(a,b);
+                        weight += w;
+                    }
+                l.min(i,j) = lo;
+                l.max(i,j) = hi;
+                l.mean(i,j) = sum / weight;
+            }
+        return l;
+    }
+
+    size_t rows, cols;
+    std::vector<level> levels;
+};
+
+#endif // FIELD_PYRAMID_HPP
@@ -0,0 +1,63 @@
+#include "frame_exporter.h"
+
+#include <thread>
+#include <QFile>
+#include <QFileInfo>
+
+QString frame_exporter::png_name(size_t k) const
+{
+    QFileInfo info(s.path);
+    QString base = info.path() + "/" + info.completeBaseName();
+    return QString("%1_%2.png").arg(base).arg(k,6,10,QChar('0'));
+}
+
+size_t frame_exporter::run(const std::vector<frame_ptr>& frames)
+{
+    done = 0;
+    if (frames.empty()) return 0;
+
+    const qint64 frame_bytes = qint64(s.size.width()) * s.size.height() * 3;
+    if (s.format == raw_rgb24)
+    {
+        QFile file(s.path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return 0;
+        file.resize(frame_bytes * frames.size());
+    }
+
+    unsigned threads = s.threads ? s.threads : std::max(1u,std::thread::hardware_concurrency());
+    threads = std::min<size_t>(threads,frames.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> written{0};
+
+    auto worker = [&]()
+    {
+        QFile raw(s.path);
+        if (s.format == raw_rgb24 && !raw.open(QIODevice::ReadWrite)) return;
+
+        for (size_t k = next++; k < frames.size() && !cancel; k = next++)
+        {
+            QImage image = heat_renderer::render_to_image(*frames[k],geometry,style,s.size);
+
+            bool ok = false;
+            if (s.format == png_sequence)
+                ok = image.save(png_name(k),"PNG");
+            else
+            {
+                image = image.convertToFormat(QImage::Format_RGB888);
+                ok = raw.seek(frame_bytes * k);
+                for (int y = 0; ok && y < image.height(); ++y)
+                    ok = raw.write(reinterpret_cast<const char*>(image.constScanLine(y)),image.width() * 3) == image.width() * 3;
+            }
+
+            if (ok) written++;
+            done++;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& t : pool) t.join();
+
+    return written;
+}
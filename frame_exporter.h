@@ -0,0 +1,49 @@
+#ifndef FRAME_EXPORTER_H
+#define FRAME_EXPORTER_H
+
+#include <atomic>
+#include <vector>
+#include <QSize>
+#include <QString>
+
+#include "heat_renderer.h"
+#include "heat_transfer_program.hpp"
+
+// Renders recorded frames offscreen on a pool of worker threads. Every worker
+// owns its QImage and QPainter; frames are independent, so the only shared
+// state is the index of the next frame to take.
+class frame_exporter
+{
+public:
+    enum format_t
+    {
+        png_sequence,   // <path>_000000.png, <path>_000001.png, ...
+        raw_rgb24       // one file of back to back width*height*3 byte frames
+    };
+
+    struct settings
+    {
+        QString path;
+        format_t format{png_sequence};
+        QSize size{1280,960};
+        unsigned threads{0}; // 0 - one per hardware thread
+    };
+
+    frame_exporter(settings s, parameters geometry, heat_renderer::render_style style)
+        : s(s), geometry(geometry), style(style) {}
+
+    // Blocks until every frame is written, returns how many were written.
+    size_t run(const std::vector<frame_ptr>& frames);
+
+    std::atomic<size_t> done{0};
+    std::atomic<bool> cancel{false};
+
+private:
+    QString png_name(size_t k) const;
+
+    settings s;
+    parameters geometry;
+    heat_renderer::render_style style;
+};
+
+#endif // FRAME_EXPORTER_H
@@ -1,99 +1,150 @@
 #include "heat_renderer.h"
 #include "heat_transfer_program.hpp"
 #include <QCursor>
+#include <cmath>
 
-void heat_renderer::paintEvent(QPaintEvent *event)
+struct heat_renderer::render_job
 {
-    if (program == nullptr) return;
+    std::shared_ptr<const recorded_frame> frame;
+    parameters geometry;
+    render_style style;
+    QRectF view;
+    QSize size;
+    QColor background;
+
+    // whether rendering this job would give the same image as other
+    bool same_image(const render_job& other) const
+    {
+        auto& a = style; auto& b = other.style;
+        bool same_range = a.adaptive_temperature || (a.T_min == b.T_min && a.T_max == b.T_max);
+        return frame == other.frame && view == other.view && size == other.size &&
+               background == other.background && same_range &&
+               a.adaptive_temperature == b.adaptive_temperature &&
+               a.do_izolines == b.do_izolines && a.izolines_size == b.izolines_size;
+    }
+};
 
-    world_rect = {0,0,program->v.r.right_bound(),program->v.z.right_bound()};
+heat_renderer::heat_renderer(QWidget *parent) : QWidget(parent)
+{
+    setFocusPolicy(Qt::ClickFocus);
+}
 
-    QPainter painter(this);
+heat_renderer::~heat_renderer()
+{
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        stopping = true;
+    }
+    render_cv.notify_all();
+    if (render_thread.joinable()) render_thread.join();
+}
 
+heat_renderer::render_style heat_renderer::style() const
+{
+    return {adaptive_temperature,T_min,T_max,do_izolines,izolines_size};
+}
 
-    QRect outer_rect = rect();
+QRect heat_renderer::plot_area(QRect outer_rect)
+{
     QRect rect = outer_rect; rect.adjust(0,60,-100,0);
+    return rect;
+}
+
+QTransform heat_renderer::world_to_screen(QRect outer_rect, QRectF world_rect)
+{
+    QRect rect = plot_area(outer_rect);
 
     QTransform transform;
     transform.translate(rect.left(),rect.bottom());
     transform.scale(rect.width()/world_rect.width(),-rect.height()/world_rect.height());
+    transform.translate(-world_rect.left(),-world_rect.top());
+    return transform;
+}
 
-    painter.setTransform(transform);
-
-
-
-
-    auto& field = *program->v.temperature_field.rbegin();
-
-
-
-
-
-    auto min_max = std::minmax_element(field.data().begin(),field.data().end());
-    if (adaptive_temperature) {T_min = *min_max.first; T_max = *min_max.second;}
-
-    for (int i = 0; i < program->v.r.size()-1; ++i) {
-        for (int j = 0; j < program->v.z.size()-1; ++j) {
-
-
-
-
-
-            //auto low_index = ceil(izolines_size*(T[0].T-T_min)/(T_max-T_min));
-            //auto high_index = floor(izolines_size*(T[2].T-T_min)/(T_max-T_min));
-            //if (low_index <= high_index)
-            //{
-            //
-            //
-            //    auto& i_ = low_index;
-            //    auto T_izoline = T_min + i_* (T_max - T_min)/float(izolines_size);
-            //
-            //    auto& x = program->v.r;
-            //    auto& y = program->v.z;
-            //    auto x_izoline_1 = -(T[1].T - T_izoline)/(T_max - T_min) *(x[T[1].i] - x[T[0].i]) + x[T[1].i];
-            //    auto y_izoline_1 = -(T[1].T - T_izoline)/(T_max - T_min) *(y[T[1].j] - y[T[0].j]) + y[T[1].j];
-            //
-            //    auto x_izoline_2 = -(T[2].T - T_izoline)/(T_max - T_min) *(x[T[2].i] - x[T[0].i]) + x[T[2].i];
-            //    auto y_izoline_2 = -(T[2].T - T_izoline)/(T_max - T_min) *(y[T[2].j] - y[T[0].j]) + y[T[2].j];
-            //
-            //    QPen pen(QColor(0,0,0,255));
-            //    pen.setCosmetic(true);
-            //    painter.setPen(pen);
-            //    painter.drawLine(x_izoline_1,y_izoline_1,x_izoline_2,y_izoline_2);
-            //}
-            //}
-
-            QPen pen(QColor(0,0,0,10));
-            pen.setCosmetic(true);
-            painter.setPen(pen);
-            QColor color = InterpolateColor(field.at_element(i,j));
-            QBrush brush(color);
-            painter.setBrush(brush);
-
-            QPointF points[4];
-            points[0] = {program->v.r[i],program->v.z[j]};
-            points[1] = {program->v.r[i],program->v.z[j+1]};
-            points[2] = {program->v.r[i+1],program->v.z[j+1]};
-            points[3] = {program->v.r[i+1],program->v.z[j]};
-            painter.drawPolygon(points,4);
+size_t heat_renderer::render(QPainter &painter, QRect outer_rect, const recorded_frame &frame,
+                             const parameters &geometry, render_style &style, QRectF view)
+{
+    auto& r = frame.r;
+    auto& z = frame.z;
+
+    if (view.isEmpty()) view = {0,0,r.right_bound(),z.right_bound()};
+    QTransform transform = world_to_screen(outer_rect,view);
+    QRect area = plot_area(outer_rect);
+    if (area.isEmpty() || r.size() < 2 || z.size() < 2) return 0;
+
+    auto& T_min = style.T_min;
+    auto& T_max = style.T_max;
+
+    auto pyramid = frame.pyramid();
+    if (style.adaptive_temperature) {T_min = pyramid->min(); T_max = pyramid->max();}
+
+    // the coarsest level that still has a cell per pixel
+    double density = std::max(view.width() / r.get_step() / area.width(),
+                              view.height() / z.get_step() / area.height());
+    size_t level = 0;
+    while (level + 1 < pyramid->size() && density >= 2) { density /= 2; ++level; }
+    auto& field = level ? (*pyramid)[level].mean : frame.T;
+
+    // level cell under every pixel column (row), -1 outside the field; node
+    // i colours the cell [x[i], x[i+1]) as before
+    auto cells_under = [level](const discrete_linspace& x, size_t level_size, int pixels,
+                               double from, double span, bool upward)
+    {
+        std::vector<long> index(pixels);
+        for (int p = 0; p < pixels; ++p)
+        {
+            double at = from + (upward ? pixels - p - 0.5 : p + 0.5) / pixels * span;
+            double c = std::floor((at - x[0]) / x.get_step());
+            index[p] = (c < 0 || c >= double(x.size() - 1)) ? -1
+                     : std::min<long>(long(c) >> level,long(level_size) - 1);
         }
+        return index;
+    };
+    auto columns = cells_under(r,field.size1(),area.width(),view.left(),view.width(),false);
+    auto rows    = cells_under(z,field.size2(),area.height(),view.top(),view.height(),true);
+
+    QImage image(area.size(),QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    for (int y = 0; y < area.height(); ++y)
+    {
+        if (rows[y] < 0) continue;
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < area.width(); ++x)
+            if (columns[x] >= 0) line[x] = InterpolateColor(field(columns[x],rows[y]),style).rgb();
     }
 
+    painter.resetTransform();
+    painter.drawImage(area.topLeft(),image);
 
+    painter.setClipRect(area);
+    painter.setTransform(transform);
 
-    if (do_izolines)
+    if (style.do_izolines)
     {
-        for (int var = 0; var < izolines_size; ++var) {
+        // on the level's grid, only over the visible cells
+        const double hx = r.get_step() * (1 << level), hy = z.get_step() * (1 << level);
+        auto X = [&](long i) { return r[0] + i * hx; };
+        auto Y = [&](long j) { return z[0] + j * hy; };
+        auto first = [](double from, double x0, double h) { return std::max(0L,long(std::floor((from - x0) / h))); };
+        const long i_begin = first(view.left(),r[0],hx), j_begin = first(view.top(),z[0],hy);
+        const long i_end = std::min<long>(field.size1() - 1,long(std::ceil((view.right() - r[0]) / hx)) + 1);
+        const long j_end = std::min<long>(field.size2() - 1,long(std::ceil((view.bottom() - z[0]) / hy)) + 1);
+
+        QPen pen(QColor(0,0,0,255));
+        pen.setCosmetic(true);
+        painter.setPen(pen);
+
+        for (int var = 0; var < style.izolines_size; ++var) {
 
-            double T_izo = T_min + var * (T_max - T_min) / (double)izolines_size;
+            double T_izo = T_min + var * (T_max - T_min) / (double)style.izolines_size;
 
-            for (int i = 0; i < program->v.r.size()-1; ++i) {
-                for (int j = 0; j < program->v.z.size()-1; ++j) {
+            for (long i = i_begin; i < i_end; ++i) {
+                for (long j = j_begin; j < j_end; ++j) {
 
                     double T[3] = {
-                        field.at_element(i,j),
-                        field.at_element(i+1,j),
-                        field.at_element(i,j+1)
+                        field(i,j),
+                        field(i+1,j),
+                        field(i,j+1)
                     };
                     auto& T_centr = T[0];
                     auto& T_right = T[1];
@@ -103,21 +154,18 @@ void heat_renderer::paintEvent(QPaintEvent *event)
                     auto [min,max] = std::minmax_element(T,T+3);
                     if ((T_izo >= *min) && (T_izo <= *max))
                     {
-                        auto& x = program->v.r;
-                        auto& y = program->v.z;
-
                         auto factor_x = (T_izo - T_centr)/(T_right - T_centr);
                         auto factor_y = (T_izo - T_centr)/(T_upper - T_centr);
-                        auto x_izoline = factor_x * x.get_step() + x[i];
-                        auto y_izoline = factor_y * y.get_step() + y[j];
+                        auto x_izoline = factor_x * hx + X(i);
+                        auto y_izoline = factor_y * hy + Y(j);
 
-                        QPointF p1(x[i],y_izoline);
-                        QPointF p2(x_izoline,y[j]);
+                        QPointF p1(X(i),y_izoline);
+                        QPointF p2(x_izoline,Y(j));
 
-                        auto mux1 = (x[i]   - p1.x())/(p2.x() - p1.x());
-                        auto mux2 = (x[i+1] - p1.x())/(p2.x() - p1.x());
-                        auto muy1 = (y[j]   - p1.y())/(p2.y() - p1.y());
-                        auto muy2 = (y[j+1] - p1.y())/(p2.y() - p1.y());
+                        auto mux1 = (X(i)   - p1.x())/(p2.x() - p1.x());
+                        auto mux2 = (X(i+1) - p1.x())/(p2.x() - p1.x());
+                        auto muy1 = (Y(j)   - p1.y())/(p2.y() - p1.y());
+                        auto muy2 = (Y(j+1) - p1.y())/(p2.y() - p1.y());
 
                         if (p2.x() - p1.x() < 0) std::swap(mux1,mux2);
                         if (p2.y() - p1.y() < 0) std::swap(muy1,muy2);
@@ -133,9 +181,6 @@ void heat_renderer::paintEvent(QPaintEvent *event)
                                     p1.y() + (p2.y() - p1.y()) * std::min(muy2,mux2)
                                     );
 
-                        QPen pen(QColor(0,0,0,255));
-                        pen.setCosmetic(true);
-                        painter.setPen(pen);
                         painter.drawLine(izopoint1,izopoint2);
                     }
                 }
@@ -149,19 +194,134 @@ void heat_renderer::paintEvent(QPaintEvent *event)
     painter.setBrush(Qt::BrushStyle::NoBrush);
     QRectF heater = {
         0,
-        program->p.height-program->p.wall_width-program->p.heater_height,
-        program->p.heater_radius,
-        program->p.heater_height
+        geometry.height-geometry.wall_width-geometry.heater_height,
+        geometry.heater_radius,
+        geometry.heater_height
     };
 
     QRectF vessel = {
         0,
-        program->p.wall_width,
-        program->p.radius- program->p.wall_width,
-        program->p.height - 2*program->p.wall_width
+        geometry.wall_width,
+        geometry.radius- geometry.wall_width,
+        geometry.height - 2*geometry.wall_width
     };
     painter.drawRect(heater);
     painter.drawRect(vessel);
+    painter.setClipping(false);
+    return level;
+}
+
+QImage heat_renderer::render_to_image(const recorded_frame &frame, const parameters &geometry,
+                                      render_style style, QSize size)
+{
+    QImage image(size,QImage::Format_RGB32);
+    image.fill(QColor(255,255,255));
+
+    QPainter painter(&image);
+    render(painter,image.rect(),frame,geometry,style);
+    painter.end();
+    return image;
+}
+
+// Hands the latest frame to the render worker unless the image for it is
+// already there or on its way.
+void heat_renderer::request_render(std::shared_ptr<const recorded_frame> frame)
+{
+    auto job = std::make_unique<render_job>(render_job{frame,program->p,style(),world_rect,size(),
+                                                       palette().color(backgroundRole())});
+    if (last_job && job->same_image(*last_job)) return;
+    last_job = std::make_unique<render_job>(*job);
+
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        pending_job = std::move(job);
+        if (!render_thread.joinable()) render_thread = std::thread([this]{ render_loop(); });
+    }
+    render_cv.notify_one();
+}
+
+void heat_renderer::render_loop()
+{
+    std::unique_lock<std::mutex> lock(render_mutex);
+    for (;;)
+    {
+        render_cv.wait(lock,[this]{ return stopping || pending_job; });
+        if (stopping) return;
+        auto job = std::move(pending_job);
+        lock.unlock();
+
+        if (back.image.size() != job->size) back.image = QImage(job->size,QImage::Format_ARGB32_Premultiplied);
+        back.image.fill(job->background);
+        QPainter painter(&back.image);
+        back.level = render(painter,back.image.rect(),*job->frame,job->geometry,job->style,job->view);
+        painter.end();
+        back.world_rect = job->view;
+        back.T_min = job->style.T_min;
+        back.T_max = job->style.T_max;
+        back.frame = job->frame;
+
+        lock.lock();
+        std::swap(front,back);
+        if (!update_posted.exchange(true))
+            QMetaObject::invokeMethod(this,"update",Qt::QueuedConnection);
+    }
+}
+
+void heat_renderer::paintEvent(QPaintEvent *event)
+{
+    if (program == nullptr) return;
+
+    auto latest = program->latest_frame();
+    if (!latest) return;
+
+    field_rect = {0,0,latest->r.right_bound(),latest->z.right_bound()};
+    world_rect = view_rect.isEmpty() ? field_rect : view_rect;
+    world_transform = world_to_screen(rect(),world_rect);
+    auto& transform = world_transform;
+
+    request_render(latest);
+    update_posted = false;
+
+    QPainter painter(this);
+
+    std::shared_ptr<const recorded_frame> frame;
+    size_t level;
+    {
+        std::lock_guard<std::mutex> lock(render_mutex);
+        if (front.image.isNull()) return;
+
+        // an image made for an older view is moved to where it belongs now
+        QTransform shown = world_to_screen(front.image.rect(),front.world_rect);
+        painter.setTransform(shown.inverted() * transform);
+        painter.drawImage(0,0,front.image);
+
+        frame = front.frame;
+        level = front.level;
+        if (adaptive_temperature) {T_min = front.T_min; T_max = front.T_max;}
+    }
+
+    auto& r = frame->r;
+    auto& z = frame->z;
+
+    painter.setTransform(transform);
+
+    QPen bound_pen(QColor(0,0,0));
+    bound_pen.setCosmetic(true);
+    painter.setPen(bound_pen);
+
+    auto probe_locations = program->probes.locations();
+    for (size_t k = 0; k < probe_locations.size(); ++k)
+    {
+        auto [probe_r, probe_z] = probe_locations[k];
+        QPointF center = transform.map(QPointF(probe_r,probe_z));
+
+        painter.save();
+        painter.resetTransform();
+        painter.setBrush(QColor(255,255,255));
+        painter.drawEllipse(center,4,4);
+        painter.drawText(center + QPointF(6,-6),QString::number(k));
+        painter.restore();
+    }
 
 
 
@@ -187,27 +347,113 @@ void heat_renderer::paintEvent(QPaintEvent *event)
 
             painter.drawRect(drawing_box_trans);
 
-            size_t i = program->v.r.closest_index(pos.x());
-            size_t j = program->v.z.closest_index(pos.y());
+            size_t i = r.closest_index(pos.x());
+            size_t j = z.closest_index(pos.y());
 
 
             QString material_str;
-            auto& m = program->material_at_point(program->v.r[i],program->v.z[j]);
+            auto& m = program->material_at_point(r[i],z[j]);
             if (std::addressof(m) == std::addressof(program->p.metal)) material_str = "metal";
             else if (std::addressof(m) == std::addressof(program->p.liquid)) material_str = "liquid";
             //else if (m == program->p.steel) material_str = "steel";
-            QString str; str.sprintf("%.3f,%.3f:\r\n{%g}\r\n%s",
-                                     program->v.r[i],program->v.z[j],
-                                     program->v.temperature_field.rbegin()->at_element(i,j),
+
+            // the values that were drawn under the cursor
+            QString value_str;
+            if (level == 0) value_str.sprintf("{%g}",frame->T.at_element(i,j));
+            else
+            {
+                auto pyramid = frame->pyramid();
+                auto& l = (*pyramid)[level];
+                size_t li = std::min(i >> level,l.mean.size1() - 1);
+                size_t lj = std::min(j >> level,l.mean.size2() - 1);
+                value_str.sprintf("{%g}\r\n[%g..%g]",l.mean(li,lj),l.min(li,lj),l.max(li,lj));
+            }
+            QString str; str.sprintf("%.3f,%.3f:\r\n%s\r\n%s",
+                                     r[i],z[j],
+                                     value_str.toStdString().c_str(),
                                      material_str.toStdString().c_str());
             painter.resetTransform();
             painter.drawText(drawing_box,Qt::AlignCenter,str);
         }
     }
+
+    if (painted && frame && frame == latest) painted(frame->step);
 }
 
-QColor heat_renderer::InterpolateColor(double T)
+void heat_renderer::mousePressEvent(QMouseEvent *event)
 {
+    if (program != nullptr && event->button() == Qt::LeftButton && !(event->modifiers() & Qt::ControlModifier))
+    {
+        dragging = true;
+        drag_origin = world_transform.inverted().map(QPointF(event->pos()));
+        return;
+    }
+
+    if (program == nullptr || !(event->modifiers() & Qt::ControlModifier))
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    if (event->button() == Qt::LeftButton)
+    {
+        QPointF pos = world_transform.inverted().map(QPointF(event->pos()));
+        if (field_rect.contains(pos)) program->probes.add(pos.x(),pos.y());
+    }
+    else if (event->button() == Qt::RightButton)
+        program->probes.clear();
+
+    update();
+}
+
+// keeps the world point grabbed on press under the cursor
+void heat_renderer::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!dragging || world_rect.isEmpty()) return QWidget::mouseMoveEvent(event);
+
+    QPointF pos = world_transform.inverted().map(QPointF(event->pos()));
+    view_rect = world_rect.translated(drag_origin - pos);
+    world_rect = view_rect;
+    world_transform = world_to_screen(rect(),world_rect);
+    update();
+}
+
+void heat_renderer::mouseReleaseEvent(QMouseEvent *event)
+{
+    dragging = false;
+    QWidget::mouseReleaseEvent(event);
+}
+
+void heat_renderer::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    view_rect = QRectF();
+    update();
+    QWidget::mouseDoubleClickEvent(event);
+}
+
+// zooms around the point under the cursor, never out past the whole field
+void heat_renderer::wheelEvent(QWheelEvent *event)
+{
+    if (world_rect.isEmpty()) return;
+
+    QPointF anchor = world_transform.inverted().map(QPointF(event->pos()));
+    double factor = std::pow(0.8,event->angleDelta().y() / 120.0);
+
+    QRectF view(anchor.x() - (anchor.x() - world_rect.left()) * factor,
+                anchor.y() - (anchor.y() - world_rect.top()) * factor,
+                world_rect.width() * factor,
+                world_rect.height() * factor);
+
+    if (view.width() >= field_rect.width() && view.height() >= field_rect.height()) view = QRectF();
+    view_rect = view;
+    update();
+}
+
+QColor heat_renderer::InterpolateColor(double T, const render_style& style)
+{
+    auto& T_min = style.T_min;
+    auto& T_max = style.T_max;
+
     QColor color1(0,0,255), color2(255,0,0);
 
     //double T_max{350.0}, T_min{250.0};
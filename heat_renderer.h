@@ -2,16 +2,29 @@
 #define HEAT_RENDERER_H
 
 #include <QKeyEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
 #include <QWidget>
 #include <QPainter>
+#include <QImage>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 //#include "heat_transfer_program.hpp"
 struct heat_transfer_program;
+struct parameters;
+struct recorded_frame;
 
 class heat_renderer : public QWidget
 {
 public:
-    heat_renderer(QWidget* parent = nullptr) : QWidget(parent){setFocusPolicy(Qt::ClickFocus);};
-    QRectF world_rect;
+    heat_renderer(QWidget* parent = nullptr);
+    ~heat_renderer();
+    QRectF world_rect; // part of the field on screen
+    QRectF view_rect;  // zoomed and panned view, empty for the whole field
 
     heat_transfer_program* program = nullptr;
 
@@ -23,13 +36,40 @@ public:
     bool do_hint = false;
     bool do_izolines = false;
 
+    QTransform world_transform;
+
+    std::function<void(unsigned long step)> painted; // called when the latest frame is on screen
+
+    // Everything the heat map drawing depends on besides the frame itself,
+    // copied out so frames can be rendered away from the widget.
+    struct render_style
+    {
+        bool adaptive_temperature;
+        double T_min, T_max;
+        bool do_izolines;
+        unsigned izolines_size;
+    };
+    render_style style() const;
+
+    // Heat map, isolines and outlines of the view (the whole field when
+    // empty); safe to call from any thread. The map is drawn from the level
+    // of the frame's pyramid that has about one cell per pixel, which is
+    // returned. With adaptive_temperature the used range is written back
+    // to style.
+    static size_t render(QPainter& painter, QRect outer_rect, const recorded_frame& frame,
+                         const parameters& geometry, render_style& style, QRectF view = QRectF());
+    static QImage render_to_image(const recorded_frame& frame, const parameters& geometry,
+                                  render_style style, QSize size);
+    static QRect plot_area(QRect outer_rect);
+    static QTransform world_to_screen(QRect outer_rect, QRectF world_rect);
+
     // QWidget interface
 protected:
 
 
 
     void paintEvent(QPaintEvent *event);
-    QColor InterpolateColor(double T);
+    static QColor InterpolateColor(double T, const render_style& style);
 
     // QWidget interface
 protected:
@@ -43,6 +83,46 @@ protected:
         if (event->key() == Qt::Key::Key_Shift)
             do_hint = false;
     }
+    // Ctrl+LMB places a probe, Ctrl+RMB removes all of them; LMB drag pans,
+    // the wheel zooms and a double click shows the whole field again
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void mouseDoubleClickEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+
+private:
+    QRectF field_rect;
+    bool dragging = false;
+    QPointF drag_origin;
+
+    // The heat map is rendered on a worker thread into the back image and
+    // swapped with the front one, which paintEvent only blits. A request
+    // that was not picked up yet is replaced by a newer one, and a finished
+    // image replaces one the GUI has not painted yet, so both sides drop
+    // stale work instead of queueing it.
+    struct render_job;
+    struct rendered_image
+    {
+        QImage image;
+        QRectF world_rect;
+        size_t level = 0;
+        double T_min = 0, T_max = 0;
+        std::shared_ptr<const recorded_frame> frame;
+    };
+
+    void request_render(std::shared_ptr<const recorded_frame> frame);
+    void render_loop();
+
+    std::thread render_thread;
+    std::mutex render_mutex;
+    std::condition_variable render_cv;
+    std::unique_ptr<render_job> pending_job; // guarded by render_mutex
+    std::unique_ptr<render_job> last_job;    // GUI thread only
+    rendered_image front;                    // guarded by render_mutex
+    rendered_image back;                     // worker only
+    bool stopping = false;
+    std::atomic<bool> update_posted{false};
 };
 
 #endif // HEAT_RENDERER_H
@@ -9,15 +9,28 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    frame_exporter.cpp \
     heat_renderer.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    qtplot.cpp
 
 
 HEADERS += \
+    cascade_solver.hpp \
+    field_pyramid.hpp \
+    frame_exporter.h \
     heat_renderer.h \
     mainwindow.h \
-    heat_transfer_program.hpp
+    heat_transfer_program.hpp \
+    partitioned_tridiagonal.hpp \
+    probe.hpp \
+    qtplot.h \
+    recording_policy.hpp \
+    shm_frame_layout.hpp \
+    shm_frame_publisher.hpp \
+    solver_scheduler.hpp \
+    thread_pool.hpp
 
 FORMS += \
     mainwindow.ui
@@ -26,6 +39,8 @@ INCLUDEPATH += \
     C:\libs\boost_1_82_0 \
     C:\my_lib
 
+unix: LIBS += -pthread -lrt
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -1,4 +1,10 @@
+#ifndef HEAT_TRANSFER_PROGRAM_HPP
+#define HEAT_TRANSFER_PROGRAM_HPP
+
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <math_functions.hpp>
@@ -8,6 +14,11 @@
 #include <physics/dimensionless.hpp>
 #include <linspace.hpp>
 
+#include "recording_policy.hpp"
+#include "probe.hpp"
+#include "partitioned_tridiagonal.hpp"
+#include "field_pyramid.hpp"
+
 #include <boost/numeric/ublas/matrix.hpp>
 
 struct rect
@@ -54,6 +65,29 @@ struct parameters : public dimensionless_variables
     unsigned z_divisions{64};
     double t_step{8e-6};
 
+    recording_policy recording;
+
+    // compact_fourth_order: Pade-type compact differences in a D'yakonov ADI
+    // step, fourth order in space away from material interfaces and
+    // convective borders, second order in time
+    enum difference_scheme {second_order, compact_fourth_order};
+    difference_scheme scheme{second_order};
+
+    // Opt-in: lines (columns of the r-sweep, rows of the z-sweep) whose last
+    // change and whose neighbours' last change are all below the tolerance
+    // are not solved; they keep their values until a neighbour moves or the
+    // next full step re-measures every line. Second order scheme only.
+    struct activity_tracking
+    {
+        bool enabled{false};
+        double tolerance{1e-7};       // max |dT| per step
+        unsigned recheck_every{50};   // steps between full steps
+    } activity;
+
+    // heat_balance::drifting is raised above this share of the energy that
+    // went in and out
+    double energy_drift_tolerance{0.05};
+
     def_variable(t,t0,1); //???
     def_variable(z,z0,sqrt(liquid.thermal_conductivity/liquid.thermal_capacity * t0));
     def_variable(T,T0,1); //basically does nothing...
@@ -61,47 +95,393 @@ struct parameters : public dimensionless_variables
 
 typedef boost::numeric::ublas::matrix<double> mat;
 
+// Energy accounting of a run in the solver's units, per radian: energies
+// are sums of C*T over cylindrical control volumes (r dr dz), powers their
+// rates. Input and loss are integrated (trapezoid) from the baseline, which
+// is reset by init() and by parameter changes.
+struct heat_balance
+{
+    double t = 0;
+    double liquid_energy = 0, metal_energy = 0;
+    double heater_power = 0;   // from the source term
+    double boundary_loss = 0;  // through the convective right and upper borders
+    double baseline = 0;       // total energy at the baseline
+    double input = 0, loss = 0;
+    double imbalance = 0;      // energy change not explained by input - loss
+    double drift = 0;          // |imbalance| / (input + |loss|)
+    bool drifting = false;
+};
+
+// A stored snapshot of the field. Frames are immutable once published, so
+// the renderer and exporters may keep them while the solver runs on.
+struct recorded_frame
+{
+    double t;
+    unsigned long step;
+    discrete_linspace r,z;
+    mat T;
+    heat_balance balance;
+    size_t frozen_lines;        // of parameters::activity_tracking
+    double activity_error_bound;
+
+    // built on first use from any thread; concurrent first calls may both
+    // build it, but all of them get the one that was published
+    std::shared_ptr<const field_pyramid> pyramid() const
+    {
+        auto built = std::atomic_load(&pyramid_cache);
+        if (built) return built;
+
+        std::shared_ptr<const field_pyramid> expected;
+        built = std::make_shared<const field_pyramid>(T);
+        if (!std::atomic_compare_exchange_strong(&pyramid_cache,&expected,built)) return expected;
+        return built;
+    }
+
+    mutable std::shared_ptr<const field_pyramid> pyramid_cache = {};
+};
+
+typedef std::shared_ptr<const recorded_frame> frame_ptr;
+
 struct variables
 {
-    std::list<mat> temperature_field;
-    
+    mat T; // current solver state, advanced every step
+    std::list<frame_ptr> temperature_field; // recorded frames only
+
     discrete_linspace r,z;
     double t = {};
+    unsigned long step = {};
 
     rect heater_rect;
     rect steel_rect;
+
+    // state of parameters::activity_tracking
+    struct line_activity
+    {
+        std::vector<double> r_change, z_change; // last max|dT| per column j / row i
+        std::vector<double> r_rate, z_rate;     // change measured when the line froze
+        std::vector<char> r_frozen, z_frozen;
+        unsigned long since_recheck = 0;
+        size_t frozen_lines = 0;                // in the last step
+        // Accumulated bound on the difference from the full scheme: every
+        // step adds the largest rate among the skipped lines. A frozen line
+        // barely changes, so its rate is kept from the step it froze rather
+        // than re-measured. It holds while frozen lines would keep changing
+        // no faster than when they were frozen (true near equilibrium) and
+        // the scheme does not amplify perturbations in the max norm.
+        double error_bound = 0;
+    } activity;
+
+    // material region of every node (row-major, as T); the coefficients of
+    // the scheme are looked up per region instead of per node
+    enum region_t : unsigned char {liquid_region, wall_region, heater_region, regions_count};
+    std::vector<unsigned char> region;
+    double region_lambda2[regions_count] = {};
+    double region_source[regions_count] = {};
+    double region_capacity[regions_count] = {};
+
+    // cylindrical control volumes of the nodes per radian, volume(i,j) =
+    // volume_r[i] * volume_z[j]; volume_r[i] is also the area of the node's
+    // face on the upper border
+    std::vector<double> volume_r, volume_z;
+
+    heat_balance balance;
 };
 
 class heat_transfer_program : public time_flow_program<parameters,variables>
 {
 public:
-    void init()
+    probe_set probes;
+
+    // called after every recorded frame, on the thread that recorded it
+    std::function<void(const recorded_frame&)> frame_recorded;
+
+    // grids and geometry only, without allocating the field
+    void init_geometry()
+    {
+        build_geometry(p,v);
+    }
+
+    // grid, rectangles, region map, coefficients and control volumes of q
+    // into g; nothing else in g is touched
+    static void build_geometry(const parameters& q, variables& g)
+    {
+        g.r.create_bound_dependent(0,q.radius,q.r_divisions,true);
+        g.z.create_bound_dependent(0,q.height,q.z_divisions,true);
+
+        g.heater_rect = {0,q.height - q.wall_width,q.heater_radius,q.height - q.wall_width - q.heater_height};
+        g.steel_rect = {0,q.wall_width,q.radius - q.wall_width,q.height-q.wall_width};
+
+        build_regions(q,g);
+        build_coefficients(q,g);
+
+        auto volumes = [](const discrete_linspace& x, bool radial)
+        {
+            std::vector<double> w(x.size());
+            for (size_t k = 0; k < x.size(); ++k)
+            {
+                double a = std::max(x[0],x[k] - 0.5*x.get_step());
+                double b = std::min(x[x.size()-1],x[k] + 0.5*x.get_step());
+                w[k] = radial ? 0.5*(b*b - a*a) : b - a;
+            }
+            return w;
+        };
+        g.volume_r = volumes(g.r,true);
+        g.volume_z = volumes(g.z,false);
+    }
+
+    // which region every node falls into; depends on the grid and geometry
+    static void build_regions(const parameters& q, variables& g)
+    {
+        const size_t nr = g.r.size(), nz = g.z.size();
+        g.region.resize(nr * nz);
+        for (size_t i = 0; i < nr; ++i)
+            for (size_t j = 0; j < nz; ++j)
+            {
+                double r = g.r[i], z = g.z[j];
+                g.region[i * nz + j] = in_heater(q,r,z) ? variables::heater_region
+                                     : in_wall(q,r,z)   ? variables::wall_region
+                                                        : variables::liquid_region;
+            }
+    }
+
+    // per-region coefficients; depend on the materials and the heater power
+    static void build_coefficients(const parameters& q, variables& g)
+    {
+        double metal_ratio = q.metal.lambda2 / q.liquid.lambda2;
+
+        g.region_lambda2[variables::liquid_region] = 1.0;
+        g.region_lambda2[variables::wall_region]   = metal_ratio;
+        g.region_lambda2[variables::heater_region] = metal_ratio;
+
+        g.region_source[variables::liquid_region] = 0.0;
+        g.region_source[variables::wall_region]   = 0.0;
+        g.region_source[variables::heater_region] = heater_power_density(q) / q.metal.thermal_capacity;
+
+        g.region_capacity[variables::liquid_region] = q.liquid.thermal_capacity;
+        g.region_capacity[variables::wall_region]   = q.metal.thermal_capacity;
+        g.region_capacity[variables::heater_region] = q.metal.thermal_capacity;
+    }
+
+    static void take_coefficients(variables& to, const variables& from)
+    {
+        std::copy(std::begin(from.region_lambda2),std::end(from.region_lambda2),std::begin(to.region_lambda2));
+        std::copy(std::begin(from.region_source),std::end(from.region_source),std::begin(to.region_source));
+        std::copy(std::begin(from.region_capacity),std::end(from.region_capacity),std::begin(to.region_capacity));
+    }
+
+    // Takes new parameters without restarting the run: the field, the time
+    // and the recorded frames are kept. The region map is rebuilt only when
+    // the geometry changed and the coefficients only when the materials or
+    // the power did; a new grid gets the field through remap_field(). A
+    // program that was never initialized is simply initialized.
+    // Must not run concurrently with cycle_function().
+    void apply_parameters(const parameters& np)
+    {
+        auto same = [](const parameters::material& a, const parameters::material& b)
+        {
+            return a.thermal_conductivity == b.thermal_conductivity && a.thermal_capacity == b.thermal_capacity;
+        };
+
+        bool grid = np.radius != p.radius || np.height != p.height ||
+                    np.r_divisions != p.r_divisions || np.z_divisions != p.z_divisions;
+        bool geometry = grid || np.wall_width != p.wall_width ||
+                        np.heater_height != p.heater_height || np.heater_radius != p.heater_radius;
+        bool coefficients = geometry || !same(np.metal,p.metal) || !same(np.liquid,p.liquid) ||
+                            np.heater_power != p.heater_power || np.t0 != p.t0 || np.T0 != p.T0;
+
+        if (v.T.size1() == 0) // nothing to keep yet
+        {
+            p = np;
+            return init();
+        }
+
+        // everything that may throw is built aside, so a failure leaves the
+        // program as it was
+        variables staged;
+        if (geometry) build_geometry(np,staged);
+        else if (coefficients) build_coefficients(np,staged);
+        mat T;
+        if (grid) T = remap_field(v.T,v.r,v.z,staged.r,staged.z);
+
+        p = np;
+        if (geometry)
+        {
+            std::swap(v.r,staged.r);
+            std::swap(v.z,staged.z);
+            v.heater_rect = staged.heater_rect;
+            v.steel_rect = staged.steel_rect;
+            v.region.swap(staged.region);
+            v.volume_r.swap(staged.volume_r);
+            v.volume_z.swap(staged.volume_z);
+        }
+        if (coefficients) take_coefficients(v,staged);
+        if (grid) v.T.swap(T);
+
+        reset_balance();
+        if (grid) record_frame();
+    }
+
+    // Carries T from the (r,z) grid to (new_r,new_z). Every node of the new
+    // grid gets the average over its control volume of the old piecewise
+    // constant field, with the radial direction weighted by r, so the heat
+    // content of the part both grids cover is preserved. Parts of the new
+    // domain outside the old one take the value of the nearest old cell.
+    static mat remap_field(const mat& T,
+                           const discrete_linspace& r, const discrete_linspace& z,
+                           const discrete_linspace& new_r, const discrete_linspace& new_z)
     {
-        v.r.create_bound_dependent(0,p.radius,p.r_divisions,true);
-        v.z.create_bound_dependent(0,p.height,p.z_divisions,true);
-        v.temperature_field.clear();
+        auto wr = overlap_weights(r,new_r,true);
+        auto wz = overlap_weights(z,new_z,false);
 
-        v.temperature_field.emplace_back(v.r.size(),v.z.size(),p.external_temperature);
+        mat by_r(new_r.size(),z.size(),0.0);
+        for (size_t i = 0; i < new_r.size(); ++i)
+            for (auto [a,w] : wr[i])
+                for (size_t j = 0; j < z.size(); ++j)
+                    by_r(i,j) += w * T(a,j);
+
+        mat result(new_r.size(),new_z.size(),0.0);
+        for (size_t i = 0; i < new_r.size(); ++i)
+            for (size_t j = 0; j < new_z.size(); ++j)
+                for (auto [b,w] : wz[j])
+                    result(i,j) += w * by_r(i,b);
+        return result;
+    }
+
+    // normalized overlaps of the control volumes of `to` with those of
+    // `from`; a node's volume is half a step around it, clipped to the ends
+    static std::vector<std::vector<std::pair<size_t,double>>>
+    overlap_weights(const discrete_linspace& from, const discrete_linspace& to, bool radial)
+    {
+        auto lo = [](const discrete_linspace& x, size_t k) { return std::max(x[0],x[k] - 0.5*x.get_step()); };
+        auto hi = [](const discrete_linspace& x, size_t k) { return std::min(x[x.size()-1],x[k] + 0.5*x.get_step()); };
+        auto measure = [radial](double a, double b) { return radial ? 0.5*(b*b - a*a) : b - a; };
+
+        std::vector<std::vector<std::pair<size_t,double>>> weights(to.size());
+        size_t first = 0;
+        for (size_t k = 0; k < to.size(); ++k)
+        {
+            double a = lo(to,k), b = hi(to,k);
+            while (first + 1 < from.size() && hi(from,first) <= a) ++first;
+
+            double total = 0;
+            for (size_t m = first; m < from.size() && lo(from,m) < b; ++m)
+            {
+                double w = measure(std::max(a,lo(from,m)),std::min(b,hi(from,m)));
+                if (w <= 0) continue;
+                weights[k].emplace_back(m,w);
+                total += w;
+            }
+
+            if (total > 0)
+                for (auto& e : weights[k]) e.second /= total;
+            else // outside the old domain
+                weights[k] = {{to[k] < from[0] ? 0 : from.size()-1,1.0}};
+        }
+        return weights;
+    }
+
+    void init()
+    {
+        init_geometry();
+        v.T = mat(v.r.size(),v.z.size(),p.external_temperature);
         v.t = 0;
+        v.step = 0;
+        v.activity = {};
+        reset_balance();
+
+        {
+            std::lock_guard<std::mutex> lock(frames_mutex);
+            v.temperature_field.clear();
+        }
+        record_frame();
+
+        probes.reset();
+        probes.sample(v.t,v.T,v.r,v.z);
+    }
+
+    frame_ptr latest_frame() const
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        if (v.temperature_field.empty()) return nullptr;
+        return v.temperature_field.back();
+    }
+
+    std::list<frame_ptr> recorded_frames() const
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        return v.temperature_field;
+    }
+
+    // Takes the current field as the baseline of v.balance; call after
+    // replacing v.T or the grid by hand.
+    void reset_balance()
+    {
+        balance_rows.resize(v.r.size());
+        for (size_t i = 0; i < v.r.size(); ++i) balance_rows[i] = row_balance(v.T,i);
+        v.balance = {};
+        v.balance = current_balance(balance_rows);
+        v.balance.baseline = v.balance.liquid_energy + v.balance.metal_energy;
+    }
+
+    // heat balance of every recorded frame, oldest first
+    std::vector<heat_balance> heat_balance_series() const
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        std::vector<heat_balance> series;
+        series.reserve(v.temperature_field.size());
+        for (auto& frame : v.temperature_field) series.push_back(frame->balance);
+        return series;
+    }
+
+    size_t recorded_frames_count() const
+    {
+        std::lock_guard<std::mutex> lock(frames_mutex);
+        return v.temperature_field.size();
+    }
+
+    void record_frame()
+    {
+        auto frame = std::make_shared<const recorded_frame>(recorded_frame{v.t,v.step,v.r,v.z,v.T,v.balance,
+                                                                              v.activity.frozen_lines,v.activity.error_bound});
+
+        {
+            std::lock_guard<std::mutex> lock(frames_mutex);
+            v.temperature_field.push_back(frame);
+            auto& max_history = p.recording.max_history;
+            while (max_history && v.temperature_field.size() > max_history)
+                v.temperature_field.pop_front();
+        }
+        if (frame_recorded) frame_recorded(*frame);
+    }
+
+    bool in_wall(double r, double z) const { return in_wall(p,r,z); }
+    bool in_heater(double r, double z) const { return in_heater(p,r,z); }
+    double heater_power_density() const { return heater_power_density(p); }
 
-        v.heater_rect = {0,p.height - p.wall_width,p.heater_radius,p.height - p.wall_width - p.heater_height};
-        v.steel_rect = {0,p.wall_width,p.radius - p.wall_width,p.height-p.wall_width};
+    static bool in_wall(const parameters& q, double r, double z)
+    {
+        return (r > q.radius - q.wall_width) || (z < q.wall_width) || (z > q.height - q.wall_width);
+    }
+
+    static bool in_heater(const parameters& q, double r, double z)
+    {
+        return (r < q.heater_radius) && (z > q.height - q.wall_width - q.heater_height) && (z < q.height - q.wall_width);
+    }
+
+    static double heater_power_density(const parameters& q)
+    {
+        return q.heater_power * q.t0 / q.metal.thermal_capacity / q.T0;
     }
 
     parameters::material& material_at_point(double r, double z)
     {
-        if (r > p.radius - p.wall_width) return p.metal;
-        if ((z < p.wall_width) || (z > p.height - p.wall_width)) return p.metal;
-        if ((r < p.heater_radius) && (z > p.height - p.wall_width - p.heater_height) && (z < p.height - p.wall_width)) return p.metal;
+        if (in_wall(r,z) || in_heater(r,z)) return p.metal;
         else return p.liquid;
     }
 
     double heat_power_func(double r, double z)
     {
-        if (r < p.heater_radius)
-            if ((z > p.height - p.wall_width - p.heater_height) && (z < p.height - p.wall_width))
-                return p.heater_power * p.t0 / p.metal.thermal_capacity / p.T0;
-        return 0.0;
+        return in_heater(r,z) ? heater_power_density() : 0.0;
     }
 
     double lambda2_func(double r, double z)
@@ -112,34 +492,124 @@ public:
         else return p.liquid.lambda2;
     }
 
-    void cycle_function()
+    // out = wr*(d2T/dr2 + 1/r*dT/dr) + wz*d2T/dz2 in a single pass over T.
+    // The operator is the same as differentiating twice with
+    // my_functions::differentiate (central differences, one-sided at the
+    // ends), so away from the edges d2 is (T[k+2]-2T[k]+T[k-2])/(4h^2).
+    // Columns are walked in blocks so the five rows the stencil touches stay
+    // in L1 while i advances. On the axis the 1/r term is replaced by its
+    // limit, 2*d2T/dr2.
+    void explicit_operator(const mat& T, double wr, double wz, mat& out) const
     {
-        auto& prev_T = *v.temperature_field.rbegin();
+        explicit_operator(T,wr,wz,out,0,0,0,T.size1(),0,T.size2());
+    }
 
-        mat T(v.r.size(),v.z.size());
+    // Same on a block of the field: T holds global rows [i_off, i_off+size1)
+    // and columns [j_off, j_off+size2), out (shaped as T) is filled for the
+    // local rows [ib,ie) and columns [jb,je). Those need two neighbours on
+    // every side inside T unless they lie on the edge of the whole grid.
+    void explicit_operator(const mat& T, double wr, double wz, mat& out,
+                           size_t i_off, size_t j_off,
+                           size_t ib, size_t ie, size_t jb, size_t je) const
+    {
+        const long nr = v.r.size();
+        const long nz = v.z.size();
+        const size_t ld = T.size2();
+        const double dr = v.r.get_step();
+        const double dz = v.z.get_step();
+        const double q_dr2 = 0.25 / dr / dr, q_dz2 = 0.25 / dz / dz;
+        const double half_dr = 0.5 / dr;
+        constexpr size_t block = 256;
+
+        // local columns with two neighbours on both sides inside the grid
+        const size_t fast_jb = std::clamp<long>(2 - long(j_off), jb, je);
+        const size_t fast_je = std::clamp<long>(nz - 2 - long(j_off), fast_jb, je);
 
-        mat dTdr    (v.r.size(),v.z.size());
-        mat dTdz    (v.r.size(),v.z.size());
-        mat d2Tdr2  (v.r.size(),v.z.size());
-        mat d2Tdz2  (v.r.size(),v.z.size());
+        const double* t = &T.data()[0];
+        double* o = &out.data()[0];
 
-        for (size_t i = 0; i < v.z.size(); i++) my_functions::differentiate(v.r.get_step(),(prev_T.begin2()+i).begin(),(prev_T.begin2()+i).end(),(dTdr.begin2()+i).begin());
-        for (size_t i = 0; i < v.r.size(); i++) my_functions::differentiate(v.z.get_step(),(prev_T.begin1()+i).begin(),(prev_T.begin1()+i).end(),(dTdz.begin1()+i).begin());
-        for (size_t i = 0; i < v.z.size(); i++) my_functions::differentiate(v.r.get_step(),(dTdr.begin2()+i).begin(),(dTdr.begin2()+i).end(),(d2Tdr2.begin2()+i).begin());
-        for (size_t i = 0; i < v.r.size(); i++) my_functions::differentiate(v.z.get_step(),(dTdz.begin1()+i).begin(),(dTdz.begin1()+i).end(),(d2Tdz2.begin1()+i).begin());
+        for (size_t j0 = jb; j0 < je; j0 += block)
+        {
+            const size_t j1 = std::min(j0 + block, je);
 
+            for (size_t i = ib; i < ie; ++i)
+            {
+                const long gi = long(i + i_off);
+                const double* c = t + i * ld;
+                double* res = o + i * ld;
 
-        auto l2 = [&](unsigned i, unsigned j) {return material_at_point(v.r[i],v.z[j]).lambda2 /p.liquid.lambda2;};
-        auto Q = [&](unsigned i, unsigned j){return heat_power_func(v.r[i],v.z[j])/material_at_point(v.r[i],v.z[j]).thermal_capacity;};
-        double& dt = p.t_step;
-        double dr = v.r.get_step();
-        double dz = v.z.get_step();
+                if (gi >= 2 && gi + 2 < nr)
+                {
+                    const double r_coef = 1.0 / v.r[gi];
+                    const double *m2 = c - 2*ld, *m1 = c - ld, *p1 = c + ld, *p2 = c + 2*ld;
+                    for (size_t j = j0; j < j1; ++j)
+                    {
+                        double d2r = (p2[j] - 2*c[j] + m2[j]) * q_dr2;
+                        double d1r = (p1[j] - m1[j]) * half_dr;
+                        res[j] = wr * (d2r + r_coef * d1r);
+                    }
+                }
+                else
+                {
+                    for (size_t j = j0; j < j1; ++j)
+                    {
+                        double d2r = line_d2(c + j,ld,nr,gi,dr);
+                        double Lr = (gi == 0) ? 2 * d2r : d2r + line_d1(c + j,ld,nr,gi,dr) / v.r[gi];
+                        res[j] = wr * Lr;
+                    }
+                }
+
+                const size_t fb = std::clamp(fast_jb, j0, j1);
+                const size_t fe = std::clamp(fast_je, fb, j1);
+                for (size_t j = j0; j < fb; ++j)
+                    res[j] += wz * line_d2(c + j,1,nz,j + j_off,dz);
+                for (size_t j = fb; j < fe; ++j)
+                    res[j] += wz * (c[j+2] - 2*c[j] + c[j-2]) * q_dz2;
+                for (size_t j = fe; j < j1; ++j)
+                    res[j] += wz * line_d2(c + j,1,nz,j + j_off,dz);
+            }
+        }
+    }
+
+    // first and second derivative at point k of a line of n values spaced by
+    // stride, matching my_functions::differentiate applied once and twice;
+    // a points at the k-th value
+    static double line_d1(const double* a, long stride, long n, long k, double h)
+    {
+        if (k == 0)     return (a[stride] - a[0]) / h;
+        if (k == n - 1) return (a[0] - a[-stride]) / h;
+        return (a[stride] - a[-stride]) / (2*h);
+    }
+
+    static double line_d2(const double* a, long stride, long n, long k, double h)
+    {
+        if (k == 0)     return (line_d1(a + stride,stride,n,1,h) - line_d1(a,stride,n,0,h)) / h;
+        if (k == n - 1) return (line_d1(a,stride,n,k,h) - line_d1(a - stride,stride,n,k-1,h)) / h;
+        return (line_d1(a + stride,stride,n,k+1,h) - line_d1(a - stride,stride,n,k-1,h)) / (2*h);
+    }
 
+    double lambda2_ratio(size_t i, size_t j) const
+    {
+        return v.region_lambda2[v.region[i * v.z.size() + j]];
+    }
+
+    double source(size_t i, size_t j) const
+    {
+        return v.region_source[v.region[i * v.z.size() + j]];
+    }
+
+    struct sweep_borders
+    {
+        boundary_condition_first_order left, bottom, right, upper;
+    };
+
+    sweep_borders borders() const
+    {
+        double dr = v.r.get_step();
 
         auto& e = p.epsilon;
         auto& t_e = p.external_temperature;
         auto& k_m = p.metal.thermal_conductivity;
-        auto& k_g = p.glass.thermal_conductivity;
 
         boundary_condition_first_order left_border(1.0,0.0);
         boundary_condition_first_order bottom_border(1.0,0.0);
@@ -154,50 +624,288 @@ public:
             t_e/(k_m/e/dr + 1)
         );
 
-        // time step [t_i -> t_i+0.5*dt]
-        run_through_method<double> by_r;
-        for (size_t j = 0; j < v.z.size(); j++)
+        return {left_border,bottom_border,right_border,upper_border};
+    }
+
+    // time step [t_i -> t_i+0.5*dt] along r at column j;
+    // prev(i) is the field, L(i) the explicit side, result in by_r.output
+    template <typename Solver, typename Prev, typename Expl>
+    void solve_r_line(Solver& by_r, const sweep_borders& b, size_t j, const Prev& prev_T, const Expl& L)
+    {
+        double dt = p.t_step;
+        double dr = v.r.get_step();
+        auto l2 = [&](unsigned i) {return lambda2_ratio(i,j);};
+        auto Q  = [&](unsigned i) {return source(i,j);};
+
+        by_r.A = [&](unsigned i){ return    -l2(i) * dt / 4.0 * (1.0 / dr / dr - 0.5 / dr / v.r[i]); };
+        by_r.B = [&](unsigned i){ return 1 + l2(i) * dt / 2.0 / dr / dr; };
+        by_r.C = [&](unsigned i){ return    -l2(i) * dt / 4.0 * (1.0 / dr / dr + 0.5 / dr / v.r[i]); };
+        by_r.D = [&](unsigned i){ return    prev_T(i) + dt / 4.0 * (l2(i)*L(i) + 2*Q(i)); };
+
+        by_r.evaluate(v.r.size(),
+                      1./b.left.mu,b.left.nu/b.left.mu,
+                      b.right.mu,b.right.nu
+                      );
+    }
+
+    // time step [t_i+0.5*dt -> t_i+1] along z at row i
+    template <typename Solver, typename Cur, typename Expl>
+    void solve_z_line(Solver& by_z, const sweep_borders& b, size_t i, const Cur& T, const Expl& L)
+    {
+        double dt = p.t_step;
+        double dz = v.z.get_step();
+        auto l2 = [&](unsigned j) {return lambda2_ratio(i,j);};
+        auto Q  = [&](unsigned j) {return source(i,j);};
+
+        by_z.A = [&](unsigned j){return    -l2(j)*dt/4.0/dz/dz;};
+        by_z.B = [&](unsigned j){return 1 + l2(j)*dt/2.0/dz/dz;};
+        by_z.C = [&](unsigned j){return    -l2(j)*dt/4.0/dz/dz;};
+        by_z.D = [&](unsigned j){return T(j) + dt/2.0 * (l2(j)*L(j)+Q(j));};
+
+        by_z.evaluate(v.z.size(),
+                      1.0/b.bottom.mu,b.bottom.nu/b.bottom.mu,
+                      b.upper.mu,b.upper.nu
+                      );
+    }
+
+    // indices of the heater's side (r_i) and bottom (z_j) faces
+    std::pair<unsigned,unsigned> heater_faces() const
+    {
+        unsigned r_i = v.heater_rect.right / v.r.get_step();
+        unsigned z_j = v.heater_rect.bottom / v.z.get_step();
+        return {r_i,z_j};
+    }
+
+    // whether both heater faces lie strictly inside the grid, so the
+    // interface nodes have neighbours on both sides; without a heater
+    // (zero radius or height) there is no interface to treat
+    bool heater_faces_inside() const
+    {
+        auto [r_i, z_j] = heater_faces();
+        return r_i > 0 && z_j > 0 && r_i + 1 < v.r.size() && z_j + 1 < v.z.size();
+    }
+
+    boundary_condition_second_order steel_to_water() const
+    {
+        return boundary_condition_second_order(p.metal.thermal_conductivity,p.liquid.thermal_conductivity);
+    }
+
+    // Runs f(solver, k) for lines k in [0,lines). Lines go to the pool's
+    // threads when there are enough of them; otherwise every line is split
+    // over the threads by the partitioned solver.
+    template <typename F>
+    void for_each_line(size_t lines, size_t line_length, F f)
+    {
+        auto& pool = shared_thread_pool();
+        if (line_solvers.size() != pool.size()) line_solvers.resize(pool.size());
+
+        if (line_solver<double>::prefer_partitioned(line_length,lines,pool))
+        {
+            line_solvers[0].pool = &pool;
+            for (size_t k = 0; k < lines; ++k) f(line_solvers[0],k);
+            line_solvers[0].pool = nullptr;
+        }
+        else
+            pool.parallel_for(lines,[&](size_t k, unsigned worker){ f(line_solvers[worker],k); });
+    }
+
+    // Three-point stencils of the compact scheme at node k of a line: Pade
+    // weights m and differences l with sum m*f = sum l*T + O(h^4), f being
+    // the operator applied to T. Next to a material interface m is the
+    // identity and l the second order operator. An insulated end reflects
+    // the line, folding the missing neighbour onto the other one.
+    struct compact_stencil
+    {
+        double m[3], l[3];
+
+        // sum (m + c*l)*x over the stencil at k of a line of n values
+        template <typename Line>
+        double apply(double c, const Line& x, size_t k, size_t n) const
         {
-            //double Q = heat_power_func(); //Функция мощности тепла
-            by_r.A = [&](unsigned i){ return    -l2(i,j) * dt / 4.0 * (1.0 / dr / dr - 0.5 / dr / v.r[i]); };
-            by_r.B = [&](unsigned i){ return 1 + l2(i,j) * dt / 2.0 / dr / dr; };
-            by_r.C = [&](unsigned i){ return    -l2(i,j) * dt / 4.0 * (1.0 / dr / dr + 0.5 / dr / v.r[i]); };
-            by_r.D = [&](unsigned i){ return    prev_T(i, j) + dt / 4.0 * (l2(i,j)*(d2Tdr2(i,j) + dTdr(i,j)/v.r[i] + 2*d2Tdz2(i,j))+ 2*Q(i,j)); };
+            double sum = (m[1] + c*l[1]) * x(k);
+            if (k > 0)     sum += (m[0] + c*l[0]) * x(k-1);
+            if (k + 1 < n) sum += (m[2] + c*l[2]) * x(k+1);
+            return sum;
+        }
 
+        void fold_lower() { m[2] += m[0]; l[2] += l[0]; m[0] = l[0] = 0; }
+        void fold_upper() { m[0] += m[2]; l[0] += l[2]; m[2] = l[2] = 0; }
+    };
 
+    // d2T/dr2 + 1/r*dT/dr at (i,j):
+    //   Lh = (1 - h^2/(12r^2)) d2/h^2 + (1/r + h^2/(12r^3)) d0/(2h),
+    //   weights (1 -+ h/(2r))/12 and 10/12;
+    // on the axis, where T is even in r, 3/4*f0 + 1/4*f1 = 4*(T1 - T0)/h^2
+    compact_stencil compact_r(size_t i, size_t j) const
+    {
+        const size_t n = v.r.size(), nz = v.z.size();
+        const double h = v.r.get_step();
+        auto region = [&](size_t k){ return v.region[k * nz + j]; };
+        bool uniform = (i == 0 || region(i-1) == region(i)) && (i + 1 == n || region(i+1) == region(i));
 
-            by_r.evaluate(v.r.size(),
-                          1./left_border.mu,left_border.nu/left_border.mu,
-                          right_border.mu,right_border.nu
-                          );
-            std::move(by_r.output.begin(),by_r.output.end(),(T.begin2()+j).begin());
+        if (i == 0)
+            return {{0,uniform ? 0.75 : 1.0,uniform ? 0.25 : 0.0},{0,-4/h/h,4/h/h}};
+
+        const double r = v.r[i];
+        compact_stencil st;
+        if (uniform)
+        {
+            double a = 1 - h*h/(12*r*r), b = 1/r + h*h/(12*r*r*r);
+            st = {{(1 - 0.5*h/r)/12,10.0/12,(1 + 0.5*h/r)/12},
+                  {a/h/h - 0.5*b/h,-2*a/h/h,a/h/h + 0.5*b/h}};
+        }
+        else
+            st = {{0,1,0},{1/h/h - 0.5/h/r,-2/h/h,1/h/h + 0.5/h/r}};
+        if (i + 1 == n)
+        {
+            // dT/dr = 0 on an insulated wall makes d3T/dr3 = -f/r there, so
+            // the mirrored node is T[n-2] - h^3/(3r)*f rather than T[n-2]
+            if (uniform) st.m[1] += st.l[2] * h*h*h / (3*r);
+            st.fold_upper();
         }
+        return st;
+    }
+
+    // d2T/dz2 at (i,j): weights 1/12, 10/12, 1/12
+    compact_stencil compact_z(size_t i, size_t j) const
+    {
+        const size_t n = v.z.size();
+        const double h = v.z.get_step();
+        const unsigned char* region = &v.region[i * n];
+        bool uniform = (j == 0 || region[j-1] == region[j]) && (j + 1 == n || region[j+1] == region[j]);
+
+        compact_stencil st{{0,1,0},{1/h/h,-2/h/h,1/h/h}};
+        if (uniform) st.m[0] = st.m[2] = 1.0/12, st.m[1] = 10.0/12;
+        if (j == 0) st.fold_lower();
+        if (j + 1 == n) st.fold_upper();
+        return st;
+    }
+
+    // Crank-Nicolson in D'yakonov form with compact operators,
+    //   (Mr - dt/2 Lr)(Mz - dt/2 Lz) T' = (Mr + dt/2 Lr)(Mz + dt/2 Lz) T + dt Q,
+    // solved as one tridiagonal sweep per direction through W. Q is constant
+    // inside each material and M is the identity at its edges, so M Q = Q.
+    // The axis and the bottom are insulated; the right and upper borders
+    // keep the closures of the second order scheme unless epsilon is 0.
+    void compact_sweeps(const mat& prev_T, mat& T, mat& W)
+    {
+        const size_t nr = v.r.size(), nz = v.z.size();
+        const double half_dt = 0.5 * p.t_step;
+        const bool insulated = p.epsilon == 0;
+        const auto b = borders();
 
-        for (size_t i = 0; i < v.z.size(); i++) my_functions::differentiate(v.r.get_step(),(T.begin2()+i).begin(),(T.begin2()+i).end(),(dTdr.begin2()+i).begin());
-        for (size_t i = 0; i < v.r.size(); i++) my_functions::differentiate(v.z.get_step(),(T.begin1()+i).begin(),(T.begin1()+i).end(),(dTdz.begin1()+i).begin());
-        for (size_t i = 0; i < v.z.size(); i++) my_functions::differentiate(v.r.get_step(),(dTdr.begin2()+i).begin(),(dTdr.begin2()+i).end(),(d2Tdr2.begin2()+i).begin());
-        for (size_t i = 0; i < v.r.size(); i++) my_functions::differentiate(v.z.get_step(),(dTdz.begin1()+i).begin(),(dTdz.begin1()+i).end(),(d2Tdz2.begin1()+i).begin());
+        mat G(nr,nz);
+        shared_thread_pool().parallel_for(nr,[&](size_t i, unsigned)
+        {
+            auto row = [&](size_t k){ return prev_T(i,k); };
+            for (size_t j = 0; j < nz; ++j)
+                G(i,j) = compact_z(i,j).apply(half_dt * lambda2_ratio(i,j),row,j,nz);
+        });
 
+        // rows of (M - dt/2 L) x = rhs for one line, every stencil built once
+        auto build_line = [&](line_solver<double>& solver, size_t n, auto stencil, auto lambda2, auto rhs)
+        {
+            solver.a.resize(n); solver.b.resize(n); solver.c.resize(n); solver.d.resize(n);
+            for (size_t k = 0; k < n; ++k)
+            {
+                compact_stencil st = stencil(k);
+                double w = half_dt * lambda2(k);
+                solver.a[k] = st.m[0] - w * st.l[0];
+                solver.b[k] = st.m[1] - w * st.l[1];
+                solver.c[k] = st.m[2] - w * st.l[2];
+                solver.d[k] = rhs(st,w,k);
+            }
+            solver.A = [&solver](unsigned k){ return solver.a[k]; };
+            solver.B = [&solver](unsigned k){ return solver.b[k]; };
+            solver.C = [&solver](unsigned k){ return solver.c[k]; };
+            solver.D = [&solver](unsigned k){ return solver.d[k]; };
+        };
 
+        // the row solved at an insulated end, y[n-1] = k*y[n-2] + m
+        auto end_row = [](const line_solver<double>& solver, size_t last)
+        {
+            return std::pair<double,double>(-solver.a[last] / solver.b[last],solver.d[last] / solver.b[last]);
+        };
 
-        // time step [t_i+0.5*dt -> t_i+1]
-        run_through_method<double> by_z;    
-        for (size_t i = 1; i < v.z.size(); i++)
+        for_each_line(nz,nr,[&](line_solver<double>& by_r, size_t j)
         {
-            by_z.A = [&](unsigned j){return    -l2(i,j)*dt/4.0/dz/dz;};
-            by_z.B = [&](unsigned j){return 1 + l2(i,j)*dt/2.0/dz/dz;};
-            by_z.C = [&](unsigned j){return    -l2(i,j)*dt/4.0/dz/dz;};
-            by_z.D = [&](unsigned j){return T(i,j) + dt/2.0 * (l2(i,j)*(d2Tdr2(i,j)+dTdr(i,j)/v.r[i] + d2Tdz2(i,j)/2.0)+Q(i,j));};
+            auto column = [&](size_t k){ return G(k,j); };
+            build_line(by_r,nr,
+                       [&](size_t i){ return compact_r(i,j); },
+                       [&](size_t i){ return lambda2_ratio(i,j); },
+                       [&](const compact_stencil& st, double w, size_t i)
+                       { return st.apply(w,column,i,nr) + p.t_step * source(i,j); });
 
-            
+            auto [k2, m2] = insulated ? end_row(by_r,nr - 1) : std::pair<double,double>(b.right.mu,b.right.nu);
+            by_r.evaluate(nr,-by_r.c[0] / by_r.b[0],by_r.d[0] / by_r.b[0],k2,m2);
+            std::move(by_r.output.begin(),by_r.output.end(),(W.begin2()+j).begin());
+        });
+
+        for_each_line(nr,nz,[&](line_solver<double>& by_z, size_t i)
+        {
+            build_line(by_z,nz,
+                       [&](size_t j){ return compact_z(i,j); },
+                       [&](size_t j){ return lambda2_ratio(i,j); },
+                       [&](const compact_stencil&, double, size_t j){ return W(i,j); });
 
-            by_z.evaluate(v.z.size(),
-                          1.0/bottom_border.mu,bottom_border.nu/bottom_border.mu,
-                          upper_border.mu,upper_border.nu
-                          );
+            auto [k2, m2] = insulated ? end_row(by_z,nz - 1) : std::pair<double,double>(b.upper.mu,b.upper.nu);
+            by_z.evaluate(nz,-by_z.c[0] / by_z.b[0],by_z.d[0] / by_z.b[0],k2,m2);
             std::move(by_z.output.begin(),by_z.output.end(),(T.begin1()+i).begin());
-        }
+            balance_rows[i] = row_balance(T,i);
+        });
+    }
+
+    // the original scheme: each half-step is implicit along one direction
+    // with the wide explicit operator on the other side
+    void second_order_sweeps(const mat& prev_T, mat& T, mat& L, const sweep_borders& b)
+    {
+        explicit_operator(prev_T,1.0,2.0,L);
+
+        bool tracking = p.activity.enabled && select_frozen_lines();
+        auto& a = v.activity;
+
+        for_each_line(v.z.size(),v.r.size(),[&](line_solver<double>& by_r, size_t j)
+        {
+            if (tracking && a.r_frozen[j])
+            {
+                for (size_t i = 0; i < v.r.size(); ++i) T(i,j) = prev_T(i,j);
+                return;
+            }
+            solve_r_line(by_r,b,j,
+                         [&](unsigned i){ return prev_T(i,j); },
+                         [&](unsigned i){ return L(i,j); });
+            std::move(by_r.output.begin(),by_r.output.end(),(T.begin2()+j).begin());
+        });
+
+        explicit_operator(T,1.0,0.5,L);
+
+        for_each_line(v.r.size()-1,v.z.size(),[&](line_solver<double>& by_z, size_t line)
+        {
+            size_t i = line + 1;
+            if (!tracking || !a.z_frozen[i])
+            {
+                solve_z_line(by_z,b,i,
+                             [&](unsigned j){ return T(i,j); },
+                             [&](unsigned j){ return L(i,j); });
+                std::move(by_z.output.begin(),by_z.output.end(),(T.begin1()+i).begin());
+            }
+            balance_rows[i] = row_balance(T,i); // the row is still in cache
+        });
+    }
+
+    void cycle_function()
+    {
+        auto& prev_T = v.T;
+
+        mat T(v.r.size(),v.z.size());
+        mat L(v.r.size(),v.z.size()); // explicit side of the current half-step
+
+        double& dt = p.t_step;
+        auto b = borders();
+        if (balance_rows.size() != v.r.size()) reset_balance();
 
+        if (p.scheme == parameters::compact_fourth_order) compact_sweeps(prev_T,T,L);
+        else second_order_sweeps(prev_T,T,L,b);
 
         //for (int i = 0; i < v.r.size(); ++i) {
         //    T(i,0) = left_and_bottom_border(T(i,1));
@@ -218,24 +926,182 @@ public:
         //}
 
 
-        boundary_condition_second_order steel_to_water(p.metal.thermal_conductivity,p.liquid.thermal_conductivity);
-        boundary_condition_second_order steel_to_glass(p.metal.thermal_conductivity,p.glass.thermal_conductivity);
-        boundary_condition_second_order water_to_glass(p.liquid.thermal_conductivity,p.glass.thermal_conductivity);
+        auto steel_to_water = this->steel_to_water();
+        auto [r_i, z_j] = heater_faces();
 
-        unsigned r_i = v.heater_rect.right / v.r.get_step();
-        unsigned z_j = v.heater_rect.bottom / v.z.get_step();
+        if (heater_faces_inside())
+        {
+            for (unsigned i = 0; i < r_i; ++i) {
+                double old = T(i,z_j);
+                T(i,z_j) = steel_to_water(T(i,z_j+1),T(i,z_j-1));
+                double e = v.volume_r[i] * v.volume_z[z_j] * v.region_capacity[v.region[i*v.z.size() + z_j]] * (T(i,z_j) - old);
+                (v.region[i*v.z.size() + z_j] == variables::liquid_region ? balance_rows[i].liquid : balance_rows[i].metal) += e;
+            }
+            for (unsigned j = 0; j < z_j; ++j) {
+                T(r_i,j) = steel_to_water(T(r_i-1,j),T(r_i+1,j));
+            }
+            balance_rows[r_i] = row_balance(T,r_i);
+        }
+        balance_rows[0] = row_balance(T,0); // the axis row is not z-swept
+
+
+
+
+        if (p.activity.enabled && p.scheme == parameters::second_order) measure_activity(prev_T,T);
+
+        v.T = std::move(T);
+        v.t+= dt;
+        v.step++;
+
+        update_balance(balance_rows);
+
+        probes.sample(v.t,v.T,v.r,v.z);
+
+        auto last = latest_frame();
+        if (!last || p.recording.should_record(v.step,v.t,last->step,last->t,v.T,last->T))
+            record_frame();
+    }
+
+private:
+    // energy of one row of T by material, the source power in it and the
+    // loss through the convective borders it touches
+    struct row_sums
+    {
+        double liquid = 0, metal = 0, input = 0, loss = 0;
+    };
 
-        for (int i = 0; i < r_i; ++i) {
-            T(i,z_j) = steel_to_water(T(i,z_j+1),T(i,z_j-1));
+    row_sums row_balance(const mat& T, size_t i) const
+    {
+        const size_t nr = v.r.size(), nz = v.z.size();
+        const double* t = &T.data()[i * nz];
+        const unsigned char* region = &v.region[i * nz];
+        const double wr = v.volume_r[i];
+        const double t_e = p.external_temperature;
+        // border flux e*(T - t_e) in the units of the energy equation
+        const double h = p.epsilon * p.liquid.thermal_capacity / p.liquid.thermal_conductivity;
+
+        row_sums sums;
+        for (size_t j = 0; j < nz; ++j)
+        {
+            double c = v.region_capacity[region[j]] * wr * v.volume_z[j];
+            double e = c * t[j];
+            if (region[j] == variables::liquid_region) sums.liquid += e;
+            else sums.metal += e;
+            sums.input += c * v.region_source[region[j]];
         }
-        for (int j = 0; j < z_j; ++j) {
-            T(r_i,j) = steel_to_water(T(r_i-1,j),T(r_i+1,j));
+        sums.loss = h * (t[nz-1] - t_e) * wr;
+        if (i + 1 == nr)
+            for (size_t j = 0; j < nz; ++j) sums.loss += h * (t[j] - t_e) * v.r[i] * v.volume_z[j];
+        return sums;
+    }
+
+    // totals of the current field without integrating
+    heat_balance current_balance(const std::vector<row_sums>& rows) const
+    {
+        heat_balance b = v.balance;
+        b.t = v.t;
+        b.liquid_energy = b.metal_energy = b.heater_power = b.boundary_loss = 0;
+        for (auto& row : rows)
+        {
+            b.liquid_energy += row.liquid;
+            b.metal_energy += row.metal;
+            b.heater_power += row.input;
+            b.boundary_loss += row.loss;
         }
+        return b;
+    }
 
-        
+    void update_balance(const std::vector<row_sums>& rows)
+    {
+        const heat_balance& prev = v.balance;
+        heat_balance b = current_balance(rows);
+        double dt = b.t - prev.t;
+        b.input += 0.5 * dt * (prev.heater_power + b.heater_power);
+        b.loss  += 0.5 * dt * (prev.boundary_loss + b.boundary_loss);
+        b.imbalance = b.liquid_energy + b.metal_energy - b.baseline - (b.input - b.loss);
+        double through = std::abs(b.input) + std::abs(b.loss);
+        b.drift = through > 0 ? std::abs(b.imbalance) / through : 0;
+        b.drifting = b.drift > p.energy_drift_tolerance;
+        v.balance = b;
+    }
+
+    // Decides which lines the coming step skips and accounts for them in
+    // the error bound; false on a full step.
+    bool select_frozen_lines()
+    {
+        auto& a = v.activity;
+        const size_t nr = v.r.size(), nz = v.z.size();
 
+        if (a.r_change.size() != nz || a.z_change.size() != nr || a.since_recheck >= p.activity.recheck_every)
+        {
+            a.since_recheck = 0;
+            a.frozen_lines = 0;
+            a.r_frozen.assign(nz,0);
+            a.z_frozen.assign(nr,0);
+            return false;
+        }
+        a.since_recheck++;
 
-        v.temperature_field.emplace_back(std::move(T));
-        v.t+= dt;
+        const double tol = p.activity.tolerance;
+        auto quiet = [tol](const std::vector<double>& change, size_t k)
+        {
+            return change[k] < tol && (k == 0 || change[k-1] < tol) && (k + 1 == change.size() || change[k+1] < tol);
+        };
+
+        // a line that stays frozen keeps its rate, one that freezes now
+        // takes its last change as the rate
+        auto freeze = [&](std::vector<char>& frozen, std::vector<double>& rate, const std::vector<double>& change)
+        {
+            const size_t n = change.size();
+            std::vector<char> was_frozen(n,0);
+            if (frozen.size() == n && rate.size() == n) was_frozen = frozen;
+            rate.resize(n,0.0);
+            frozen.assign(n,0);
+
+            double skipped = 0;
+            for (size_t k = 0; k < n; ++k)
+            {
+                if (!quiet(change,k)) continue;
+                if (!was_frozen[k]) rate[k] = change[k];
+                frozen[k] = 1;
+                a.frozen_lines++;
+                skipped = std::max(skipped,rate[k]);
+            }
+            return skipped;
+        };
+
+        a.frozen_lines = 0;
+        double skipped = std::max(freeze(a.r_frozen,a.r_rate,a.r_change),
+                                  freeze(a.z_frozen,a.z_rate,a.z_change));
+
+        a.error_bound += skipped;
+        return a.frozen_lines > 0;
+    }
+
+    void measure_activity(const mat& before, const mat& after)
+    {
+        auto& a = v.activity;
+        a.r_change.assign(after.size2(),0.0);
+        a.z_change.assign(after.size1(),0.0);
+        for (size_t i = 0; i < after.size1(); ++i)
+            for (size_t j = 0; j < after.size2(); ++j)
+            {
+                double d = std::abs(after(i,j) - before(i,j));
+                a.r_change[j] = std::max(a.r_change[j],d);
+                a.z_change[i] = std::max(a.z_change[i],d);
+            }
+
+        // a line skipped in this step shows no change of its own; count it
+        // at its frozen rate so it is not taken as quieter than it is
+        for (size_t j = 0; j < a.r_frozen.size() && j < a.r_rate.size(); ++j)
+            if (a.r_frozen[j]) a.r_change[j] = std::max(a.r_change[j],a.r_rate[j]);
+        for (size_t i = 0; i < a.z_frozen.size() && i < a.z_rate.size(); ++i)
+            if (a.z_frozen[i]) a.z_change[i] = std::max(a.z_change[i],a.z_rate[i]);
     }
+
+    mutable std::mutex frames_mutex;
+    std::vector<line_solver<double>> line_solvers; // one per pool thread
+    std::vector<row_sums> balance_rows;            // filled by the z-sweep
 };
+
+#endif // HEAT_TRANSFER_PROGRAM_HPP
@@ -0,0 +1,152 @@
+#ifndef LOCAL_SOCKET_TRANSPORT_HPP
+#define LOCAL_SOCKET_TRANSPORT_HPP
+
+#include "transport.hpp"
+
+#if defined(__unix__)
+
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Ranks are processes on one host connected pairwise by AF_UNIX socket pairs.
+class local_socket_transport : public transport
+{
+public:
+    // peers[q] - socket connected to rank q, -1 for the own rank
+    local_socket_transport(int rank, std::vector<int> peers) : me(rank), peers(std::move(peers)) {}
+
+    ~local_socket_transport()
+    {
+        for (int fd : peers) if (fd >= 0) ::close(fd);
+    }
+
+    int rank() const override { return me; }
+    int size() const override { return int(peers.size()); }
+
+    void sendrecv(int to, const void* send_data, size_t send_bytes,
+                  int from, void* recv_data, size_t recv_bytes) override
+    {
+        auto out = static_cast<const char*>(send_data);
+        auto in = static_cast<char*>(recv_data);
+        size_t sent = (to < 0) ? send_bytes : 0;
+        size_t got = (from < 0) ? recv_bytes : 0;
+
+        while (sent < send_bytes || got < recv_bytes)
+        {
+            pollfd fds[2];
+            int count = 0, send_slot = -1, recv_slot = -1;
+            if (sent < send_bytes) { send_slot = count; fds[count++] = {peers[to],POLLOUT,0}; }
+            if (got < recv_bytes)  { recv_slot = count; fds[count++] = {peers[from],POLLIN,0}; }
+
+            if (::poll(fds,count,-1) < 0)
+            {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("local_socket_transport: poll failed");
+            }
+
+            if (send_slot >= 0 && (fds[send_slot].revents & (POLLOUT | POLLERR | POLLHUP)))
+            {
+                ssize_t n = ::send(peers[to],out + sent,send_bytes - sent,MSG_DONTWAIT | MSG_NOSIGNAL);
+                if (n > 0) sent += n;
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    throw std::runtime_error("local_socket_transport: send failed");
+            }
+            if (recv_slot >= 0 && (fds[recv_slot].revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                ssize_t n = ::recv(peers[from],in + got,recv_bytes - got,MSG_DONTWAIT);
+                if (n > 0) got += n;
+                else if (n == 0) throw std::runtime_error("local_socket_transport: peer closed");
+                else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    throw std::runtime_error("local_socket_transport: recv failed");
+            }
+        }
+    }
+
+private:
+    int me;
+    std::vector<int> peers;
+};
+
+// Forks n-1 children connected to the caller and to each other, then runs
+// body on every rank; the caller is rank 0. Returns body's result on rank 0,
+// or the first nonzero exit code of a child.
+inline int spawn_local_ranks(int n, const std::function<int(transport&)>& body)
+{
+    // sockets[a][b] - end of the a<->b pair owned by rank a
+    std::vector<std::vector<int>> sockets(n,std::vector<int>(n,-1));
+    for (int a = 0; a < n; ++a)
+        for (int b = a + 1; b < n; ++b)
+        {
+            int pair[2];
+            if (::socketpair(AF_UNIX,SOCK_STREAM,0,pair) != 0)
+                throw std::runtime_error("spawn_local_ranks: socketpair failed");
+            int buffer = 4 << 20;
+            for (int fd : pair)
+            {
+                ::setsockopt(fd,SOL_SOCKET,SO_SNDBUF,&buffer,sizeof(buffer));
+                ::setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&buffer,sizeof(buffer));
+            }
+            sockets[a][b] = pair[0];
+            sockets[b][a] = pair[1];
+        }
+
+    auto keep_only = [&](int rank)
+    {
+        for (int a = 0; a < n; ++a)
+            if (a != rank)
+                for (int fd : sockets[a]) if (fd >= 0) ::close(fd);
+    };
+
+    std::vector<pid_t> children;
+    for (int rank = 1; rank < n; ++rank)
+    {
+        std::fflush(nullptr);
+        pid_t pid = ::fork();
+        if (pid < 0) throw std::runtime_error("spawn_local_ranks: fork failed");
+        if (pid == 0)
+        {
+            keep_only(rank);
+            int code = 1;
+            try
+            {
+                local_socket_transport t(rank,sockets[rank]);
+                code = body(t);
+            }
+            catch (const std::exception& e)
+            {
+                std::fprintf(stderr,"rank %d: %s\n",rank,e.what());
+            }
+            std::fflush(nullptr);
+            ::_exit(code);
+        }
+        children.push_back(pid);
+    }
+
+    keep_only(0);
+    int result;
+    {
+        local_socket_transport t(0,sockets[0]);
+        result = body(t);
+    }
+
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        ::waitpid(pid,&status,0);
+        if (result == 0 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+            result = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+    return result;
+}
+
+#endif // __unix__
+
+#endif // LOCAL_SOCKET_TRANSPORT_HPP
@@ -1,5 +1,10 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "frame_exporter.h"
+#include "cascade_solver.hpp"
+
+#include <QFileDialog>
+#include <cstdlib>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -7,7 +12,26 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
 
+#if defined(__unix__)
+    // recorded frames also go to shared memory for external tools
+    const char* shm_name = std::getenv("HEAT_TRANSFER_SHM");
+    try
+    {
+        shm_publisher = std::make_unique<shm_frame_publisher>(shm_name ? shm_name : "/heat_transfer");
+        program.frame_recorded = [this](const recorded_frame& frame){ shm_publisher->publish(frame); };
+    }
+    catch (const std::runtime_error&) {}
+#endif
+
     ui->h_renderer->program = &program;
+    ui->h_renderer->painted = [this](unsigned long step){ scheduler.frame_displayed(step); };
+    apply_pacing();
+
+    auto& plot = *ui->probe_plot;
+    plot.title = "Датчики (Ctrl+ЛКМ - добавить, Ctrl+ПКМ - убрать)";
+    plot.captionX = "t";
+    plot.captionY = "T";
+    for (auto& pen : plot.plot_pens) pen.setCosmetic(true);
     this->on_pushButton_3_clicked();
 
     timer1.setInterval(1000/30);
@@ -16,6 +40,9 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    scheduler.stop();
+    stop_export();
+    stop_cascade();
     delete ui;
 }
 
@@ -28,16 +55,18 @@ void MainWindow::on_pushButton_clicked()
 
     if (running)
     {
-        program.start_loop();
+        scheduler.start();
         timer1.start();
-        ui->pushButton_3->setEnabled(false);
+        ui->reset_button->setEnabled(false);
+        ui->cascade_button->setEnabled(false);
         ui->pushButton->setText("СТОП");
     }
     else
     {
-        program.stop_loop();
+        scheduler.stop();
         timer1.stop();
-        ui->pushButton_3->setEnabled(true);
+        ui->reset_button->setEnabled(true);
+        ui->cascade_button->setEnabled(true);
         ui->pushButton->setText("СТАРТ");
     }
 }
@@ -45,8 +74,23 @@ void MainWindow::on_pushButton_clicked()
 
 void MainWindow::timer1_start()
 {
-    ui->h_renderer->repaint();
-    QString str; str.sprintf("время системы: %f",program.v.t);
+    ui->h_renderer->update();
+    update_probe_plot();
+    QString str; str.sprintf("время системы: %f\nкадров записано: %zu\nшагов/с: %.0f",
+                             program.v.t,program.recorded_frames_count(),scheduler.steps_per_second());
+    if (auto frame = program.latest_frame()) // the live state belongs to the solver thread
+    {
+        if (program.p.activity.enabled)
+        {
+            QString activity; activity.sprintf("\nпропущено линий: %zu, оценка ошибки: %g",
+                                               frame->frozen_lines,frame->activity_error_bound);
+            str += activity;
+        }
+        const heat_balance& b = frame->balance;
+        QString balance; balance.sprintf("\nнагрев: %g, потери: %g\nдисбаланс энергии: %.1f%%%s",
+                                         b.heater_power,b.boundary_loss,100*b.drift,b.drifting ? " (!)" : "");
+        str += balance;
+    }
     ui->label->setText(str);
 }
 
@@ -54,9 +98,38 @@ void MainWindow::timer1_start()
 
 
 
+void MainWindow::update_probe_plot()
+{
+    auto& plot = *ui->probe_plot;
+    size_t n = program.probes.size();
+    size_t generation = program.probes.generation();
+    if (n != probe_cursors.size() || generation != probe_generation) // added probes or a restart
+    {
+        probe_cursors.assign(n,0);
+        plot.points.assign(n,{});
+        probe_generation = generation;
+    }
+
+    std::vector<probe_sample> samples;
+    for (size_t k = 0; k < n; ++k)
+    {
+        samples.clear();
+        size_t read_generation;
+        size_t written = program.probes.read(k,probe_cursors[k],samples,&read_generation);
+        if (read_generation != probe_generation) break; // restarted meanwhile, start over next time
+        probe_cursors[k] = written;
+
+        for (auto& s : samples) plot.points[k].append(QPointF(s.t,s.T));
+    }
+    plot.update();
+}
+
+
+// Applies the form to the program as it is, keeping the current field; the
+// solver is paused for the moment the parameters are swapped.
 void MainWindow::on_pushButton_3_clicked()
 {
-    auto& prp =program.p;
+    parameters prp = program.p;
 
     prp.liquid = parameters::material(
                 ui->conductivity_liquid->text().toDouble(),
@@ -81,6 +154,30 @@ void MainWindow::on_pushButton_3_clicked()
     prp.z_divisions           = ui->z_divisions->text().toUInt();
     prp.t_step                = ui->t_step->text().toDouble();
 
+    prp.recording.mode = static_cast<recording_policy::mode_t>(ui->recording_mode->currentIndex());
+    switch (prp.recording.mode)
+    {
+    case recording_policy::every_n_steps:    prp.recording.n_steps   = ui->recording_value->text().toUInt();   break;
+    case recording_policy::time_interval:    prp.recording.interval  = ui->recording_value->text().toDouble(); break;
+    case recording_policy::change_threshold: prp.recording.threshold = ui->recording_value->text().toDouble(); break;
+    default: break;
+    }
+
+    prp.activity.enabled   = ui->activity_tracking->isChecked();
+    prp.activity.tolerance = ui->activity_tolerance->text().toDouble();
+
+    prp.scheme = ui->compact_scheme->isChecked() ? parameters::compact_fourth_order : parameters::second_order;
+
+    bool running = scheduler.running();
+    if (running) scheduler.stop();
+    program.apply_parameters(prp);
+    if (running) scheduler.start();
+    ui->centralwidget->repaint();
+}
+
+
+void MainWindow::on_reset_button_clicked()
+{
     program.init();
     ui->centralwidget->repaint();
 }
@@ -92,3 +189,133 @@ void MainWindow::on_do_izolines_stateChanged(int arg1)
     else if (arg1 == Qt::Unchecked) ui->h_renderer->do_izolines = false;
 }
 
+
+
+// cancels an export in progress and waits for its thread
+void MainWindow::stop_export()
+{
+    if (exporter) exporter->cancel = true;
+    if (export_thread.joinable()) export_thread.join();
+}
+
+
+void MainWindow::on_export_button_clicked()
+{
+    stop_export();
+
+    QString selected_filter;
+    QString path = QFileDialog::getSaveFileName(this,"Экспорт кадров","frame.png",
+                                                "PNG (*.png);;Raw RGB24 (*.rgb)",&selected_filter);
+    if (path.isEmpty()) return;
+
+    frame_exporter::settings s;
+    s.path = path;
+    s.format = selected_filter.startsWith("Raw") ? frame_exporter::raw_rgb24 : frame_exporter::png_sequence;
+
+    auto recorded = program.recorded_frames();
+    std::vector<frame_ptr> frames(recorded.begin(),recorded.end());
+
+    ui->export_button->setEnabled(false);
+    exporter = std::make_unique<frame_exporter>(s,program.p,ui->h_renderer->style());
+    export_thread = std::thread([this,s,frames,exporter = exporter.get()]()
+    {
+        size_t written = exporter->run(frames);
+
+        QMetaObject::invokeMethod(this,[this,written,total = frames.size(),size = s.size]()
+        {
+            QString str; str.sprintf("экспортировано кадров: %zu из %zu (%dx%d)",written,total,size.width(),size.height());
+            ui->label->setText(str);
+            ui->export_button->setEnabled(true);
+        },Qt::QueuedConnection);
+    });
+}
+
+
+// cancels a cascade in progress and waits for its thread
+void MainWindow::stop_cascade()
+{
+    if (cascade) cascade->cancel = true;
+    if (cascade_thread.joinable()) cascade_thread.join();
+}
+
+
+// Brings the current field close to steady state through coarser grids;
+// the program ends up on the grid from the form, ready to be started. The
+// cascade runs on a private copy of the program, so the timer and the
+// renderer never see the grid change under them; the result is swapped in
+// here on the GUI thread.
+void MainWindow::on_cascade_button_clicked()
+{
+    stop_cascade();
+
+    for (auto button : {ui->pushButton,ui->pushButton_3,ui->reset_button,ui->cascade_button})
+        button->setEnabled(false);
+
+    cascade_program = std::make_unique<heat_transfer_program>();
+    auto& copy = *cascade_program;
+    copy.p = program.p;
+    copy.init_geometry();
+    copy.v.T = program.v.T;
+    copy.v.t = program.v.t;
+    copy.v.step = program.v.step;
+    copy.reset_balance();
+    cascade = std::make_unique<cascade_solver>(copy);
+
+    cascade_thread = std::thread([this]()
+    {
+        auto reports = cascade->run();
+
+        QMetaObject::invokeMethod(this,[this,reports]()
+        {
+            if (cascade_thread.joinable()) cascade_thread.join();
+
+            auto& result = cascade_program->v;
+            program.p = cascade_program->p;
+            program.init_geometry();
+            program.v.T = std::move(result.T);
+            program.v.t = result.t;
+            program.v.step = result.step;
+            program.v.activity = {};
+            program.reset_balance();
+            program.record_frame();
+            cascade.reset();
+            cascade_program.reset();
+
+            QString str, line;
+            for (auto& level : reports)
+            {
+                line.sprintf("%ux%u: шагов %lu, невязка %g, %.2f с\n",level.r_divisions,level.z_divisions,
+                             level.steps,level.residual,level.seconds);
+                str += line;
+            }
+            ui->h_renderer->update();
+            ui->label->setText(str);
+            for (auto button : {ui->pushButton,ui->pushButton_3,ui->reset_button,ui->cascade_button})
+                button->setEnabled(true);
+        },Qt::QueuedConnection);
+    });
+}
+
+
+void MainWindow::apply_pacing()
+{
+    typedef solver_scheduler<heat_transfer_program> scheduler_t;
+
+    scheduler_t::settings s;
+    s.mode = static_cast<scheduler_t::mode_t>(ui->pacing_mode->currentIndex());
+    if (s.mode == scheduler_t::steps_per_frame) s.steps_per_frame = ui->pacing_value->text().toUInt();
+    if (s.mode == scheduler_t::real_time)       s.real_time_ratio = ui->pacing_value->text().toDouble();
+    scheduler.configure(s);
+}
+
+
+void MainWindow::on_pacing_mode_currentIndexChanged(int index)
+{
+    apply_pacing();
+}
+
+
+void MainWindow::on_pacing_value_editingFinished()
+{
+    apply_pacing();
+}
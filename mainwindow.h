@@ -3,13 +3,20 @@
 
 #include <QMainWindow>
 #include <QTimer>
+#include <memory>
+#include <thread>
 #include "heat_transfer_program.hpp"
+#include "solver_scheduler.hpp"
+#include "shm_frame_publisher.hpp"
 
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+class frame_exporter;
+class cascade_solver;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -26,11 +33,37 @@ private slots:
 
 
     void on_pushButton_3_clicked();
+    void on_reset_button_clicked();
 
     void on_do_izolines_stateChanged(int arg1);
 
+    void on_export_button_clicked();
+    void on_cascade_button_clicked();
+
+    void on_pacing_mode_currentIndexChanged(int index);
+    void on_pacing_value_editingFinished();
+
 private:
     Ui::MainWindow *ui;
     QTimer timer1;
+
+    std::vector<size_t> probe_cursors;
+    size_t probe_generation = 0;
+    void update_probe_plot();
+
+    std::unique_ptr<frame_exporter> exporter; // the one export_thread runs
+    std::thread export_thread;
+    void stop_export();
+    std::unique_ptr<heat_transfer_program> cascade_program; // private copy the cascade runs on
+    std::unique_ptr<cascade_solver> cascade;
+    std::thread cascade_thread;
+    void stop_cascade();
+
+    solver_scheduler<heat_transfer_program> scheduler{program};
+    void apply_pacing();
+
+#if defined(__unix__)
+    std::unique_ptr<shm_frame_publisher> shm_publisher;
+#endif
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,174 @@
+#ifndef PARTITIONED_TRIDIAGONAL_HPP
+#define PARTITIONED_TRIDIAGONAL_HPP
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <physics/tridiagonal_matrix_algorithm.hpp>
+
+#include "thread_pool.hpp"
+
+// Tridiagonal solve of a single line split over threads (SPIKE-style
+// partition method). With rows
+//     A(k)*y[k-1] + B(k)*y[k] + C(k)*y[k+1] = D(k),   0 < k < n-1
+//     y[0] = k1*y[1] + m1,   y[n-1] = k2*y[n-2] + m2
+// as in run_through_method, every part is solved by Thomas on its own for the
+// right side and for the two spikes left by the cut couplings:
+//     y[k] = x[k] + yl[k]*y[s-1] + yr[k]*y[e]
+// The first and last values of every part then form a pentadiagonal system
+// of 2*(parts-1) unknowns, solved serially, and the parts are finished in
+// parallel. Same arithmetic as Thomas up to the order of rounding.
+template <typename T>
+class partitioned_tridiagonal
+{
+public:
+    std::vector<T> output;
+
+    void evaluate(thread_pool& pool, unsigned parts,
+                  const std::function<T(unsigned)>& A, const std::function<T(unsigned)>& B,
+                  const std::function<T(unsigned)>& C, const std::function<T(unsigned)>& D,
+                  unsigned n, T k1, T m1, T k2, T m2)
+    {
+        parts = std::max(1u,std::min(parts,n / 4));
+        a.resize(n); b.resize(n); c.resize(n); d.resize(n);
+        x.resize(n); yl.resize(n); yr.resize(n); cp.resize(n);
+        output.resize(n);
+
+        auto part = [&](unsigned p) { return std::make_pair(size_t(n) * p / parts,size_t(n) * (p + 1) / parts); };
+
+        pool.parallel_for(parts,[&](size_t p, unsigned)
+        {
+            auto [s, e] = part(p);
+            for (size_t k = s; k < e; ++k)
+            {
+                if (k == 0)          { a[k] = 0;   b[k] = 1; c[k] = -k1; d[k] = m1; }
+                else if (k == n - 1) { a[k] = -k2; b[k] = 1; c[k] = 0;   d[k] = m2; }
+                else                 { a[k] = A(k); b[k] = B(k); c[k] = C(k); d[k] = D(k); }
+            }
+            solve_part(s,e,p > 0,p + 1 < parts);
+        });
+
+        // reduced system: w[2m] = y[e_m - 1], w[2m+1] = y[e_m] (first of part m+1)
+        size_t N = 2 * (parts - 1);
+        band.assign(N * 5,0);
+        rhs.assign(N,0);
+        auto at = [&](size_t row, size_t col) -> T& { return band[row * 5 + (col + 2 - row)]; };
+
+        for (unsigned m = 0; m + 1 < parts; ++m)
+        {
+            size_t last = part(m).second - 1;
+            size_t first = last + 1;
+
+            at(2*m,2*m) = 1;
+            if (m > 0) at(2*m,2*m - 2) = -yl[last];
+            at(2*m,2*m + 1) = -yr[last];
+            rhs[2*m] = x[last];
+
+            at(2*m + 1,2*m + 1) = 1;
+            at(2*m + 1,2*m) = -yl[first];
+            if (m + 2 < parts) at(2*m + 1,2*m + 3) = -yr[first];
+            rhs[2*m + 1] = x[first];
+        }
+
+        for (size_t r = 0; r < N; ++r)
+            for (size_t rr = r + 1; rr < std::min(r + 3,N); ++rr)
+            {
+                T f = at(rr,r) / at(r,r);
+                if (f == 0) continue;
+                for (size_t col = r; col < std::min(r + 3,N); ++col) at(rr,col) -= f * at(r,col);
+                rhs[rr] -= f * rhs[r];
+            }
+        for (size_t r = N; r-- > 0;)
+        {
+            T sum = rhs[r];
+            for (size_t col = r + 1; col < std::min(r + 3,N); ++col) sum -= at(r,col) * rhs[col];
+            rhs[r] = sum / at(r,r);
+        }
+
+        pool.parallel_for(parts,[&](size_t p, unsigned)
+        {
+            auto [s, e] = part(p);
+            T left  = (p > 0)         ? rhs[2*(p - 1)]     : 0;
+            T right = (p + 1 < parts) ? rhs[2*p + 1]       : 0;
+            for (size_t k = s; k < e; ++k) output[k] = x[k] + yl[k] * left + yr[k] * right;
+        });
+    }
+
+private:
+    // Thomas on rows [s,e) with the couplings across the cuts dropped, for
+    // the right side and the two spikes at once
+    void solve_part(size_t s, size_t e, bool has_left, bool has_right)
+    {
+        T m = b[s];
+        cp[s] = (s + 1 < e) ? c[s] / m : 0;
+        x[s] = d[s] / m;
+        yl[s] = has_left ? -a[s] / m : 0;
+        yr[s] = (s + 1 == e && has_right) ? -c[s] / m : 0;
+        for (size_t k = s + 1; k < e; ++k)
+        {
+            m = b[k] - a[k] * cp[k-1];
+            cp[k] = (k + 1 < e) ? c[k] / m : 0;
+            x[k]  = (d[k] - a[k] * x[k-1]) / m;
+            yl[k] = (-a[k] * yl[k-1]) / m;
+            yr[k] = (((k + 1 == e && has_right) ? -c[k] : 0) - a[k] * yr[k-1]) / m;
+        }
+        for (size_t k = e - 1; k-- > s;)
+        {
+            x[k]  -= cp[k] * x[k+1];
+            yl[k] -= cp[k] * yl[k+1];
+            yr[k] -= cp[k] * yr[k+1];
+        }
+    }
+
+    std::vector<T> a,b,c,d,x,yl,yr,cp;
+    std::vector<T> band,rhs;
+};
+
+// Drop-in replacement for run_through_method that picks the backend per
+// sweep: plain Thomas when there are enough lines to keep every thread busy,
+// the partitioned solver when a few long lines would leave threads idle.
+template <typename T>
+struct line_solver
+{
+    std::function<T(unsigned)> A,B,C,D;
+    std::vector<T> output;
+
+    // scratch for callers that build a line's coefficients up front and
+    // let A..D read them
+    std::vector<T> a,b,c,d;
+
+    static constexpr unsigned partitioned_min_length = 4096;
+    static constexpr unsigned min_part_length = 1024;
+
+    thread_pool* pool = nullptr; // set to split single lines over its threads
+
+    static bool prefer_partitioned(size_t line_length, size_t line_count, const thread_pool& pool)
+    {
+        return pool.size() > 1 && line_count < pool.size() && line_length >= partitioned_min_length;
+    }
+
+    void evaluate(unsigned n, T k1, T m1, T k2, T m2)
+    {
+        if (pool && n >= 2 * min_part_length)
+        {
+            unsigned parts = std::min(pool->size(),n / min_part_length);
+            partitioned.evaluate(*pool,parts,A,B,C,D,n,k1,m1,k2,m2);
+            output.swap(partitioned.output);
+            return;
+        }
+
+        std::swap(thomas.A,A); std::swap(thomas.B,B);
+        std::swap(thomas.C,C); std::swap(thomas.D,D);
+        thomas.evaluate(n,k1,m1,k2,m2);
+        std::swap(thomas.A,A); std::swap(thomas.B,B);
+        std::swap(thomas.C,C); std::swap(thomas.D,D);
+        output.swap(thomas.output);
+    }
+
+private:
+    run_through_method<T> thomas;
+    partitioned_tridiagonal<T> partitioned;
+};
+
+#endif // PARTITIONED_TRIDIAGONAL_HPP
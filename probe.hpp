@@ -0,0 +1,124 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+// Point sensors in (r,z). Every step the solver samples all probes with
+// bilinear interpolation into fixed-size rings, so long runs keep curves
+// without keeping whole frames.
+struct probe_sample
+{
+    double t;
+    double T;
+};
+
+class probe_set
+{
+public:
+    explicit probe_set(size_t capacity = 1 << 16) : capacity(capacity) {}
+
+    size_t add(double r, double z)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        probes.push_back({r,z,std::vector<probe_sample>(capacity),0});
+        return probes.size() - 1;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        probes.clear();
+    }
+
+    // forget the recorded values but keep the sensor locations; readers see
+    // a new generation
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& p : probes) p.written = 0;
+        resets++;
+    }
+
+    // number of resets so far
+    size_t generation() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return resets;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return probes.size();
+    }
+
+    std::vector<std::pair<double,double>> locations() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::pair<double,double>> result;
+        for (auto& p : probes) result.emplace_back(p.r,p.z);
+        return result;
+    }
+
+    template <typename Matrix, typename Space>
+    void sample(double t, const Matrix& T, const Space& r, const Space& z)
+    {
+        if (r.size() < 2 || z.size() < 2) return; // no cell to interpolate in
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& p : probes)
+        {
+            auto [i, wr] = cell(r,p.r);
+            auto [j, wz] = cell(z,p.z);
+
+            double value =
+                    (1-wr)*(1-wz)*T(i  ,j  ) + wr*(1-wz)*T(i+1,j  ) +
+                    (1-wr)*   wz *T(i  ,j+1) + wr*   wz *T(i+1,j+1);
+
+            p.ring[p.written % capacity] = {t,value};
+            p.written++;
+        }
+    }
+
+    // Appends samples of probe k written since the absolute index 'from' to out
+    // and returns the index to continue from. Samples that already left the
+    // ring are skipped. The generation the samples belong to goes to
+    // *generation when given.
+    size_t read(size_t k, size_t from, std::vector<probe_sample>& out, size_t* generation = nullptr) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (generation) *generation = resets;
+        if (k >= probes.size()) return 0;
+        auto& p = probes[k];
+        if (p.written > capacity) from = std::max(from, p.written - capacity);
+        for (; from < p.written; from++) out.push_back(p.ring[from % capacity]);
+        return p.written;
+    }
+
+private:
+    struct probe
+    {
+        double r,z;
+        std::vector<probe_sample> ring;
+        size_t written;
+    };
+
+    // s must have at least two nodes
+    template <typename Space>
+    static std::pair<size_t,double> cell(const Space& s, double x)
+    {
+        double h = s.get_step();
+        double f = (x - s[0]) / h;
+        f = std::clamp(f, 0.0, double(s.size() - 1));
+        size_t i = std::min(size_t(f), s.size() - 2);
+        return {i, f - i};
+    }
+
+    size_t capacity;
+    size_t resets = 0;
+    std::vector<probe> probes;
+    mutable std::mutex mutex;
+};
+
+#endif // PROBE_HPP
@@ -1,5 +1,118 @@
 #include "qtplot.h"
 #include <math.h>
+#include <algorithm>
+
+my_graphics::plot_series::plot_series(std::vector<QPointF> p)
+{
+    pts.reserve(p.size());
+    append(p.begin(),p.end());
+}
+
+void my_graphics::plot_series::clear()
+{
+    pts.clear();
+    levels.clear();
+    monotonic = true;
+    xmin = xmax = ymin = ymax = 0;
+}
+
+void my_graphics::plot_series::append(QPointF p)
+{
+    if (pts.empty())
+    {
+        xmin = xmax = p.x();
+        ymin = ymax = p.y();
+    }
+    else
+    {
+        if (p.x() < pts.back().x()) monotonic = false;
+        xmin = std::min(xmin,p.x()); xmax = std::max(xmax,p.x());
+        ymin = std::min(ymin,p.y()); ymax = std::max(ymax,p.y());
+    }
+    pts.push_back(p);
+
+    size_t i = pts.size() - 1;
+    double y = p.y();
+    for (size_t k = 0; k < levels.size(); ++k)
+    {
+        auto& level = levels[k];
+        size_t b = i >> (k + 1);
+        if (b == level.size()) level.emplace_back(y,y);
+        else
+        {
+            level[b].first  = std::min(level[b].first,y);
+            level[b].second = std::max(level[b].second,y);
+        }
+    }
+
+    // grow a coarser level once the coarsest one has more than two entries
+    while ((levels.empty() ? pts.size() : levels.back().size()) > 2)
+    {
+        std::vector<std::pair<double,double>> next;
+        if (levels.empty())
+        {
+            next.reserve((pts.size() + 1) / 2);
+            for (size_t j = 0; j < pts.size(); j += 2)
+            {
+                double a = pts[j].y();
+                double b = (j + 1 < pts.size()) ? pts[j+1].y() : a;
+                next.emplace_back(std::min(a,b),std::max(a,b));
+            }
+        }
+        else
+        {
+            auto& prev = levels.back();
+            next.reserve((prev.size() + 1) / 2);
+            for (size_t j = 0; j < prev.size(); j += 2)
+            {
+                auto a = prev[j];
+                auto b = (j + 1 < prev.size()) ? prev[j+1] : a;
+                next.emplace_back(std::min(a.first,b.first),std::max(a.second,b.second));
+            }
+        }
+        levels.emplace_back(std::move(next));
+    }
+}
+
+void my_graphics::plot_series::decimate(double x0, double x1, int pixels, std::vector<QPointF>& out) const
+{
+    out.clear();
+    if (pts.empty()) return;
+    pixels = std::max(pixels,1);
+
+    if (!monotonic || pts.size() <= size_t(2 * pixels))
+    {
+        out = pts;
+        return;
+    }
+
+    auto less_x = [](const QPointF& p, double x) { return p.x() < x; };
+    size_t lo = std::lower_bound(pts.begin(),pts.end(),x0,less_x) - pts.begin();
+    size_t hi = std::lower_bound(pts.begin(),pts.end(),x1,less_x) - pts.begin();
+    // keep one point outside on each side so the curve reaches the edges
+    if (lo > 0) lo--;
+    hi = std::min(hi + 1,pts.size());
+
+    size_t count = hi - lo;
+    if (count <= size_t(2 * pixels))
+    {
+        out.assign(pts.begin() + lo,pts.begin() + hi);
+        return;
+    }
+
+    size_t k = 0;
+    while (k + 1 < levels.size() && (count >> (k + 1)) > size_t(pixels)) k++;
+
+    auto& level = levels[k];
+    size_t shift = k + 1;
+    out.reserve(2 * ((count >> shift) + 2));
+    for (size_t b = lo >> shift; b <= (hi - 1) >> shift && b < level.size(); ++b)
+    {
+        double x = pts[b << shift].x();
+        out.emplace_back(x,level[b].first);
+        out.emplace_back(x,level[b].second);
+    }
+}
 
 my_graphics::QtPlot::QtPlot(QWidget* parent) : QWidget(parent)
 {
@@ -32,9 +145,24 @@ my_graphics::QtPlot::QtPlot(QWidget* parent) : QWidget(parent)
 
 }
 
-void my_graphics::QtPlot::save_as_file(std::wstring file_path, unsigned width, unsigned height)
+QImage my_graphics::QtPlot::render_to_image(unsigned width, unsigned height)
 {
+    QImage image(width,height,QImage::Format_ARGB32);
+    QRect r = image.rect();
+
+    accommodate(r);
+    QPainter painter(&image);
+    render(painter,r);
+    painter.end();
+
+    // transform_matrix belongs to the widget, put it back
+    accommodate(rect());
+    return image;
+}
 
+bool my_graphics::QtPlot::save_as_file(std::wstring file_path, unsigned width, unsigned height)
+{
+    return render_to_image(width,height).save(QString::fromStdWString(file_path));
 }
 
 void my_graphics::QtPlot::paintEvent(QPaintEvent *event)
@@ -102,13 +230,16 @@ void my_graphics::QtPlot::render_grid(QPainter &painter)
 
 void my_graphics::QtPlot::render_main(QPainter &painter, void *program)
 {
+    int pixels = std::ceil(transform_matrix.mapRect(worldRect).width());
+
     if (!points.empty())
         for (size_t var = 0; var < points.size(); ++var)
         {
             if (points[var].size() == 0) continue;
             if (var < plot_pens.size()) painter.setPen(plot_pens[var]);
 
-            painter.drawPolyline(points[var].data(),points[var].size());
+            points[var].decimate(worldRect.left(),worldRect.right(),pixels,lod_buffer);
+            painter.drawPolyline(lod_buffer.data(),lod_buffer.size());
         }
 }
 
@@ -157,25 +288,27 @@ void my_graphics::QtPlot::accommodate(accommodate_settings settings, QRect outer
     rect.adjust(offsetX,offsetY,-2*offsetX,-2*offsetY);
 
 
-    if (points.empty()) {
+    bool have_points = std::any_of(points.begin(), points.end(), [](auto& p) { return !p.empty(); });
+
+    if (!have_points) {
         worldRect = { -1,-1,2,2 };
     }
     else if (settings.accommodate_plot_bounds)
     {
-        std::vector<float> max_top(points.size());
-        std::vector<float> min_bottom(points.size());
-        std::vector<float> min_lefts(points.size());
-        std::vector<float> max_rights(points.size());
+        std::vector<float> max_top;
+        std::vector<float> min_bottom;
+        std::vector<float> min_lefts;
+        std::vector<float> max_rights;
 
-        for (size_t i = 0; i < points.size(); i++)
+        for (auto& series : points)
         {
-            auto a = std::minmax_element(points[i].begin(), points[i].end(), [](auto& a, auto& b) {return a.y() < b.y(); });
-            min_bottom[i] = a.first->y();
-            max_top[i] = a.second->y();
+            if (series.empty()) continue;
 
-            //!!! Dangerous place
-            min_lefts[i] = points[i].begin()->x();
-            max_rights[i] = points[i].rbegin()->x();
+            // bounds are kept up to date on append, no rescan here
+            min_bottom.push_back(series.y_min());
+            max_top.push_back(series.y_max());
+            min_lefts.push_back(series.x_min());
+            max_rights.push_back(series.x_max());
         }
         float min_y = *std::max_element(min_bottom.begin(), min_bottom.end(), [](auto& a, auto& b) {return abs(a) < abs(b); });
         float max_y = *std::max_element(max_top.begin(), max_top.end(), [](auto& a, auto& b) {return abs(a) < abs(b); });
@@ -3,16 +3,51 @@
 
 #include <QWidget>
 #include <QPainter>
+#include <QImage>
 #include <vector>
 #include <math.h>
 #include <float.h>
 
 namespace my_graphics
 {
+    // A plotted curve with running bounds and a min/max pyramid over y, so
+    // that drawing costs ~2 points per pixel column regardless of length.
+    // Decimation assumes x is non-decreasing; other curves are drawn as is.
+    class plot_series
+    {
+    public:
+        plot_series() = default;
+        plot_series(std::vector<QPointF> p);
+
+        void append(QPointF p);
+        template <typename InputIt>
+        void append(InputIt begin, InputIt end) { for (; begin != end; ++begin) append(*begin); }
+        void clear();
+
+        size_t size() const { return pts.size(); }
+        bool empty() const { return pts.empty(); }
+        const std::vector<QPointF>& raw() const { return pts; }
+
+        double x_min() const { return xmin; }
+        double x_max() const { return xmax; }
+        double y_min() const { return ymin; }
+        double y_max() const { return ymax; }
+
+        // Points of the curve within [x0,x1] reduced to about 2 per pixel.
+        void decimate(double x0, double x1, int pixels, std::vector<QPointF>& out) const;
+
+    private:
+        std::vector<QPointF> pts;
+        // levels[k][b] - (min,max) of y over pts[b*2^(k+1) .. (b+1)*2^(k+1))
+        std::vector<std::vector<std::pair<double,double>>> levels;
+        bool monotonic = true;
+        double xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+    };
+
     class QtPlot : public QWidget
     {
     public:
-        std::vector<std::vector<QPointF>> points;
+        std::vector<plot_series> points;
 
         std::vector<QFont> fonts;
 
@@ -86,7 +121,13 @@ namespace my_graphics
 
         QtPlot(QWidget* p = nullptr);
 
-        void save_as_file(std::wstring file_path, unsigned width, unsigned height );
+    private:
+        std::vector<QPointF> lod_buffer;
+
+    public:
+
+        QImage render_to_image(unsigned width, unsigned height);
+        bool save_as_file(std::wstring file_path, unsigned width, unsigned height );
 
         // QWidget interface
     protected:
@@ -149,11 +190,9 @@ namespace my_graphics
     template<typename InputIt>
     inline void QtPlot::add_points(InputIt begin, InputIt end, float width, float left)
     {
-        std::vector<QPointF> p(end - begin);
+        points.emplace_back();
         for (auto it = begin; it != end; it++)
-            p[it - begin] = { left + (it - begin) * width / (end - begin),(float)*it };
-
-        points.emplace_back(p);
+            points.back().append(QPointF{ left + (it - begin) * width / (end - begin),(float)*it });
     }
     template<typename InputIt>
     inline void QtPlot::add_points(std::initializer_list<std::pair<InputIt, InputIt>> list, float width, float left)
@@ -164,11 +203,11 @@ namespace my_graphics
     template<typename InputIt>
     inline void QtPlot::set_points(InputIt begin, InputIt end, float width, float left)
     {
-        points.clear(); points.resize(1);
-        points[0].resize(end-begin);
+        points.resize(1);
+        points[0].clear();
 
         for (auto it = begin; it != end; it++)
-            points[0][it - begin] = { left + (it - begin) * width / (end - begin),(float)*it };
+            points[0].append(QPointF{ left + (it - begin) * width / (end - begin),(float)*it });
     }
     template<typename InputIt>
     inline void QtPlot::set_points(std::initializer_list<std::pair<InputIt, InputIt>> list, float width, float left)
@@ -0,0 +1,55 @@
+#ifndef RECORDING_POLICY_HPP
+#define RECORDING_POLICY_HPP
+
+#include <cmath>
+#include <cstddef>
+
+// Decides which solver steps become stored frames. The solver still advances
+// by t_step every cycle; only the captured history is thinned out.
+struct recording_policy
+{
+    enum mode_t
+    {
+        every_step,
+        every_n_steps,
+        time_interval,
+        change_threshold
+    };
+
+    mode_t mode{time_interval};
+
+    unsigned n_steps{100};      // every_n_steps
+    double interval{1e-3};      // time_interval, in simulated time
+    double threshold{1e-3};     // change_threshold, max |T - T_last_recorded|
+
+    size_t max_history{1000};   // 0 - keep everything
+
+    template <typename Matrix>
+    bool should_record(unsigned long step, double t,
+                       unsigned long last_step, double last_t,
+                       const Matrix& T, const Matrix& last_T) const
+    {
+        switch (mode)
+        {
+        case every_step:
+            return true;
+        case every_n_steps:
+            return step - last_step >= (n_steps ? n_steps : 1);
+        case time_interval:
+            // small slack so that accumulated t_step round-off does not skip a frame
+            return t - last_t >= interval * (1 - 1e-9);
+        case change_threshold:
+        {
+            if (T.size1() != last_T.size1() || T.size2() != last_T.size2()) return true;
+            auto a = T.data().begin();
+            auto b = last_T.data().begin();
+            for (; a != T.data().end(); ++a, ++b)
+                if (std::abs(*a - *b) > threshold) return true;
+            return false;
+        }
+        }
+        return true;
+    }
+};
+
+#endif // RECORDING_POLICY_HPP
@@ -0,0 +1,55 @@
+#ifndef SHM_FRAME_LAYOUT_HPP
+#define SHM_FRAME_LAYOUT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the POSIX shared memory segment the program publishes recorded
+// frames into; shared by shm_frame_publisher and shm_frame_reader.
+//
+//   [segment_header][slot 0][slot 1]...[slot slot_count-1]
+//
+// Every slot is a frame_slot followed by nr*nz doubles, T(i,j) at i*nz + j,
+// and takes slot_bytes. Frame n (counting from 0) goes to slot
+// n % slot_count. A slot is guarded by a seqlock: its sequence is odd while
+// the writer fills it and 2n+2 once frame n is complete, so a reader checks
+// it before and after looking at the data and retries on a mismatch.
+namespace shm_frames
+{
+    constexpr uint32_t magic = 0x52465448; // "HTFR"
+    constexpr uint32_t version = 1;
+    constexpr size_t alignment = 64;
+
+    struct segment_header
+    {
+        std::atomic<uint32_t> magic;     // written last, once the layout is valid
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t reserved;
+        uint64_t slot_bytes;             // stride between slots
+        uint64_t capacity;               // doubles a slot can hold
+        std::atomic<uint64_t> published; // frames published; the latest is published-1
+        std::atomic<uint32_t> retired;   // the writer moved to a new segment, reopen
+    };
+
+    struct frame_slot
+    {
+        std::atomic<uint64_t> sequence;
+        double t;
+        uint64_t step;
+        uint32_t nr, nz;
+        double r_first, r_step;
+        double z_first, z_step;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+    constexpr size_t round_up(size_t bytes) { return (bytes + alignment - 1) / alignment * alignment; }
+    constexpr size_t header_bytes() { return round_up(sizeof(segment_header)); }
+    constexpr size_t slot_header_bytes() { return round_up(sizeof(frame_slot)); }
+    constexpr size_t slot_bytes(size_t capacity) { return round_up(slot_header_bytes() + capacity * sizeof(double)); }
+    constexpr size_t segment_bytes(size_t slots, size_t capacity) { return header_bytes() + slots * slot_bytes(capacity); }
+}
+
+#endif // SHM_FRAME_LAYOUT_HPP
@@ -0,0 +1,128 @@
+#ifndef SHM_FRAME_PUBLISHER_HPP
+#define SHM_FRAME_PUBLISHER_HPP
+
+#include "shm_frame_layout.hpp"
+
+#if defined(__unix__)
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Writes frames into a shared memory segment named like "/heat_transfer"
+// (see shm_frame_layout.hpp), one writer per segment. A frame larger than
+// the slots retires the segment and publishes into a new one under the same
+// name, big enough for it.
+class shm_frame_publisher
+{
+public:
+    shm_frame_publisher(std::string name, unsigned slots = 8, size_t capacity = 256 * 256)
+        : name(std::move(name)), slots(std::max(2u,slots))
+    {
+        create(capacity);
+    }
+
+    ~shm_frame_publisher()
+    {
+        release();
+        ::shm_unlink(name.c_str());
+    }
+
+    shm_frame_publisher(const shm_frame_publisher&) = delete;
+    shm_frame_publisher& operator=(const shm_frame_publisher&) = delete;
+
+    // Frame is anything with t, step, r, z and T as recorded_frame has.
+    template <typename Frame>
+    void publish(const Frame& frame)
+    {
+        const uint32_t nr = frame.T.size1(), nz = frame.T.size2();
+        if (size_t(nr) * nz > header->capacity)
+        {
+            header->retired.store(1,std::memory_order_release);
+            release();
+            create(size_t(nr) * nz);
+        }
+
+        uint64_t n = header->published.load(std::memory_order_relaxed);
+        auto& slot = slot_at(n % header->slot_count);
+
+        slot.sequence.store(2*n + 1,std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.t = frame.t;
+        slot.step = frame.step;
+        slot.nr = nr;
+        slot.nz = nz;
+        slot.r_first = frame.r[0];
+        slot.r_step = frame.r.get_step();
+        slot.z_first = frame.z[0];
+        slot.z_step = frame.z.get_step();
+        std::memcpy(data_at(slot),&frame.T.data()[0],sizeof(double) * nr * nz);
+
+        slot.sequence.store(2*n + 2,std::memory_order_release);
+        header->published.store(n + 1,std::memory_order_release);
+    }
+
+    const std::string& segment_name() const { return name; }
+
+private:
+    void create(size_t capacity)
+    {
+        bytes = shm_frames::segment_bytes(slots,capacity);
+
+        // a leftover segment may still be mapped by readers, never truncate it
+        ::shm_unlink(name.c_str());
+        int fd = ::shm_open(name.c_str(),O_CREAT | O_EXCL | O_RDWR,0644);
+        if (fd < 0) throw std::runtime_error("shm_frame_publisher: shm_open failed");
+        if (::ftruncate(fd,bytes) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("shm_frame_publisher: ftruncate failed");
+        }
+        void* base = ::mmap(nullptr,bytes,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        ::close(fd);
+        if (base == MAP_FAILED) throw std::runtime_error("shm_frame_publisher: mmap failed");
+
+        memory = static_cast<char*>(base);
+        header = new (memory) shm_frames::segment_header{};
+        header->version = shm_frames::version;
+        header->slot_count = slots;
+        header->slot_bytes = shm_frames::slot_bytes(capacity);
+        header->capacity = capacity;
+        for (unsigned k = 0; k < slots; ++k) new (&slot_at(k)) shm_frames::frame_slot{};
+        header->magic.store(shm_frames::magic,std::memory_order_release);
+    }
+
+    void release()
+    {
+        if (memory) ::munmap(memory,bytes);
+        memory = nullptr;
+        header = nullptr;
+    }
+
+    shm_frames::frame_slot& slot_at(size_t k)
+    {
+        return *reinterpret_cast<shm_frames::frame_slot*>(memory + shm_frames::header_bytes() + k * header->slot_bytes);
+    }
+
+    static double* data_at(shm_frames::frame_slot& slot)
+    {
+        return reinterpret_cast<double*>(reinterpret_cast<char*>(&slot) + shm_frames::slot_header_bytes());
+    }
+
+    std::string name;
+    unsigned slots;
+    size_t bytes = 0;
+    char* memory = nullptr;
+    shm_frames::segment_header* header = nullptr;
+};
+
+#endif // __unix__
+
+#endif // SHM_FRAME_PUBLISHER_HPP
@@ -0,0 +1,149 @@
+#ifndef SHM_FRAME_READER_HPP
+#define SHM_FRAME_READER_HPP
+
+#include "shm_frame_layout.hpp"
+
+#if defined(__unix__)
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Maps a segment written by shm_frame_publisher and reads its latest frame
+// in place: no copies and no system calls per frame, only when the segment
+// is (re)opened. Depends on nothing but the layout header and POSIX, so
+// external tools can take this file and shm_frame_layout.hpp alone.
+class shm_frame_reader
+{
+public:
+    // a frame as it lies in the segment; T is valid only inside read_latest()
+    struct frame_view
+    {
+        uint64_t number; // frames published before this one
+        double t;
+        uint64_t step;
+        uint32_t nr, nz;
+        double r_first, r_step;
+        double z_first, z_step;
+        const double* T; // T(i,j) at i*nz + j
+    };
+
+    explicit shm_frame_reader(std::string name) : name(std::move(name)) {}
+    ~shm_frame_reader() { close(); }
+
+    shm_frame_reader(const shm_frame_reader&) = delete;
+    shm_frame_reader& operator=(const shm_frame_reader&) = delete;
+
+    // Maps the segment if it is not mapped or the writer has moved to a new
+    // one; false while there is no valid segment under the name.
+    bool open()
+    {
+        if (header && !header->retired.load(std::memory_order_acquire)) return true;
+        close();
+
+        int fd = ::shm_open(name.c_str(),O_RDONLY,0);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd,&st) != 0 || size_t(st.st_size) < shm_frames::header_bytes())
+        {
+            ::close(fd);
+            return false;
+        }
+        void* base = ::mmap(nullptr,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+        ::close(fd);
+        if (base == MAP_FAILED) return false;
+
+        memory = static_cast<const char*>(base);
+        bytes = st.st_size;
+        header = reinterpret_cast<const shm_frames::segment_header*>(memory);
+
+        bool valid = header->magic.load(std::memory_order_acquire) == shm_frames::magic &&
+                     header->version == shm_frames::version &&
+                     shm_frames::header_bytes() + size_t(header->slot_count) * header->slot_bytes <= bytes;
+        if (!valid) close();
+        return valid;
+    }
+
+    void close()
+    {
+        if (memory) ::munmap(const_cast<char*>(memory),bytes);
+        memory = nullptr;
+        header = nullptr;
+    }
+
+    // frames published so far, 0 when not open
+    uint64_t published()
+    {
+        return open() ? header->published.load(std::memory_order_acquire) : 0;
+    }
+
+    // Calls f(const frame_view&) on the latest complete frame and returns
+    // true if the writer did not touch the slot meanwhile. On false the
+    // data f saw may be torn and must be dropped; the writer overwrites a
+    // slot only after slot_count newer frames, so a retry almost always
+    // succeeds. Keep f short for the same reason.
+    template <typename F>
+    bool read_latest(F f)
+    {
+        if (!open()) return false;
+
+        uint64_t n = header->published.load(std::memory_order_acquire);
+        if (n == 0) return false;
+        n -= 1;
+
+        auto& slot = slot_at(n % header->slot_count);
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2*n + 2) return false;
+
+        frame_view view{n,slot.t,slot.step,slot.nr,slot.nz,
+                        slot.r_first,slot.r_step,slot.z_first,slot.z_step,
+                        reinterpret_cast<const double*>(reinterpret_cast<const char*>(&slot) + shm_frames::slot_header_bytes())};
+        if (size_t(view.nr) * view.nz > header->capacity) return false;
+        f(view);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    // the latest frame copied out, for consumers that keep it
+    struct snapshot
+    {
+        frame_view frame{};
+        std::vector<double> T;
+    };
+
+    bool copy_latest(snapshot& out, unsigned attempts = 8)
+    {
+        for (unsigned k = 0; k < attempts; ++k)
+            if (read_latest([&](const frame_view& v)
+                {
+                    out.frame = v;
+                    out.T.assign(v.T,v.T + size_t(v.nr) * v.nz);
+                }))
+            {
+                out.frame.T = out.T.data();
+                return true;
+            }
+        return false;
+    }
+
+private:
+    const shm_frames::frame_slot& slot_at(size_t k) const
+    {
+        return *reinterpret_cast<const shm_frames::frame_slot*>(memory + shm_frames::header_bytes() + k * header->slot_bytes);
+    }
+
+    std::string name;
+    const char* memory = nullptr;
+    size_t bytes = 0;
+    const shm_frames::segment_header* header = nullptr;
+};
+
+#endif // __unix__
+
+#endif // SHM_FRAME_READER_HPP
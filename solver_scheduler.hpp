@@ -0,0 +1,191 @@
+#ifndef SOLVER_SCHEDULER_HPP
+#define SOLVER_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Runs Program::cycle_function() on its own thread, paced independently of
+// the display:
+//  max_throughput  - step as fast as possible, the UI samples whatever is there
+//  steps_per_frame - run exactly n steps, record a frame and wait until the UI
+//                    reports that frame (or a later one) was displayed
+//                    (reproducible demos)
+//  real_time       - keep simulated time at ratio * elapsed wall time
+template <typename Program>
+class solver_scheduler
+{
+public:
+    enum mode_t
+    {
+        max_throughput,
+        steps_per_frame,
+        real_time
+    };
+
+    struct settings
+    {
+        mode_t mode{max_throughput};
+        unsigned steps_per_frame{10};
+        double real_time_ratio{1.0}; // simulated seconds per wall-clock second
+    };
+
+    explicit solver_scheduler(Program& program) : program(program) {}
+    ~solver_scheduler() { stop(); }
+
+    void configure(settings new_settings)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        s = new_settings;
+        anchored = false;
+        cv.notify_all();
+    }
+
+    settings current() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return s;
+    }
+
+    void start()
+    {
+        if (worker.joinable()) return;
+        stop_requested = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            anchored = false;
+            frame_released = true;
+        }
+        worker = std::thread([this]{ loop(); });
+    }
+
+    void stop()
+    {
+        if (!worker.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop_requested = true;
+            cv.notify_all();
+        }
+        worker.join();
+    }
+
+    bool running() const { return worker.joinable(); }
+
+    // Called by the UI with the step of the frame now on screen
+    // (steps_per_frame only); frames recorded in the middle of a batch do
+    // not release the next one.
+    void frame_displayed(unsigned long step)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (step < batch_end) return;
+        frame_released = true;
+        cv.notify_all();
+    }
+
+    // Achieved rate since the previous call; meant to be polled by a UI timer.
+    double steps_per_second()
+    {
+        auto now = clock::now();
+        unsigned long count = steps;
+        double seconds = std::chrono::duration<double>(now - rate_time).count();
+        if (seconds > 0.5)
+        {
+            rate = (count - rate_steps) / seconds;
+            rate_steps = count;
+            rate_time = now;
+        }
+        return rate;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop_requested)
+        {
+            switch (s.mode)
+            {
+            case max_throughput:
+                lock.unlock();
+                step();
+                lock.lock();
+                break;
+
+            case steps_per_frame:
+            {
+                cv.wait(lock,[this]{ return frame_released || stop_requested || s.mode != steps_per_frame; });
+                if (stop_requested || s.mode != steps_per_frame) break;
+                frame_released = false;
+                unsigned n = s.steps_per_frame ? s.steps_per_frame : 1;
+                batch_end = program.v.step + n; // only this thread steps the program
+
+                lock.unlock();
+                for (unsigned k = 0; k < n; ++k) step();
+                auto last = program.latest_frame();
+                if (!last || last->step != program.v.step) program.record_frame();
+                lock.lock();
+                break;
+            }
+
+            case real_time:
+            {
+                if (!anchored)
+                {
+                    anchor_wall = clock::now();
+                    anchor_t = program.v.t;
+                    anchored = true;
+                }
+                double ratio = s.real_time_ratio > 0 ? s.real_time_ratio : 1.0;
+                double elapsed = std::chrono::duration<double>(clock::now() - anchor_wall).count();
+                double ahead = program.v.t - anchor_t - ratio * elapsed;
+
+                if (ahead < 0)
+                {
+                    lock.unlock();
+                    step();
+                    lock.lock();
+                }
+                else
+                {
+                    auto until = anchor_wall + std::chrono::duration_cast<clock::duration>(
+                                std::chrono::duration<double>((program.v.t - anchor_t) / ratio));
+                    cv.wait_until(lock,until);
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    void step()
+    {
+        program.cycle_function();
+        steps++;
+    }
+
+    Program& program;
+    std::thread worker;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    settings s;
+    bool stop_requested = false;
+    bool frame_released = true;
+    unsigned long batch_end = 0; // step of the frame that ends the current batch
+
+    bool anchored = false;
+    clock::time_point anchor_wall;
+    double anchor_t = 0;
+
+    std::atomic<unsigned long> steps{0};
+    unsigned long rate_steps = 0;
+    clock::time_point rate_time = clock::now();
+    double rate = 0;
+};
+
+#endif // SOLVER_SCHEDULER_HPP
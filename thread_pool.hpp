@@ -0,0 +1,107 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers for fork-join loops. The calling thread takes part
+// as worker 0. A parallel_for issued while the pool is busy (e.g. from
+// inside another parallel_for) runs inline on the caller.
+class thread_pool
+{
+public:
+    explicit thread_pool(unsigned threads = std::max(1u,std::thread::hardware_concurrency()))
+    {
+        for (unsigned w = 1; w < threads; ++w)
+            workers.emplace_back([this,w]{ work(w); });
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    unsigned size() const { return unsigned(workers.size()) + 1; }
+
+    // f(k, worker) for every k in [0,n); returns when all are done
+    void parallel_for(size_t n, const std::function<void(size_t,unsigned)>& f)
+    {
+        bool expected = false;
+        if (workers.empty() || n < 2 || !busy.compare_exchange_strong(expected,true))
+        {
+            for (size_t k = 0; k < n; ++k) f(k,0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &f;
+            count = n;
+            next = 0;
+            active = unsigned(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        run(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock,[this]{ return active == 0; });
+        task = nullptr;
+        busy = false;
+    }
+
+private:
+    void run(unsigned w)
+    {
+        for (size_t k = next++; k < count; k = next++) (*task)(k,w);
+    }
+
+    void work(unsigned w)
+    {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock,[&]{ return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+
+            lock.unlock();
+            run(w);
+            lock.lock();
+
+            if (--active == 0) done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    const std::function<void(size_t,unsigned)>* task = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+    unsigned active = 0;
+    size_t generation = 0;
+    bool quit = false;
+    std::atomic<bool> busy{false};
+};
+
+inline thread_pool& shared_thread_pool()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+#endif // THREAD_POOL_HPP
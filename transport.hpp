@@ -0,0 +1,65 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Point-to-point messaging between the ranks of a distributed run.
+// Messages between a pair of ranks arrive in the order they were sent.
+class transport
+{
+public:
+    virtual ~transport() = default;
+
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+
+    // Sends to 'to' and receives from 'from' at the same time, so that
+    // rings of exchanges cannot deadlock on full buffers. to/from may be -1
+    // to only receive/only send.
+    virtual void sendrecv(int to, const void* send_data, size_t send_bytes,
+                          int from, void* recv_data, size_t recv_bytes) = 0;
+
+    void send(int to, const void* data, size_t bytes) { sendrecv(to,data,bytes,-1,nullptr,0); }
+    void recv(int from, void* data, size_t bytes)     { sendrecv(-1,nullptr,0,from,data,bytes); }
+
+    // All-to-all of variable sized blocks as size()-1 pairwise rounds;
+    // block q of send goes to rank q, block q of recv comes from rank q.
+    void all_to_all(const std::vector<std::vector<double>>& send, std::vector<std::vector<double>>& recv)
+    {
+        int n = size(), me = rank();
+        recv[me] = send[me];
+        for (int k = 1; k < n; ++k)
+        {
+            int to = (me + k) % n;
+            int from = (me - k + n) % n;
+            sendrecv(to,send[to].data(),send[to].size() * sizeof(double),
+                     from,recv[from].data(),recv[from].size() * sizeof(double));
+        }
+    }
+
+    void barrier()
+    {
+        char token = 0, got = 0;
+        int n = size(), me = rank();
+        for (int k = 1; k < n; k <<= 1)
+            sendrecv((me + k) % n,&token,1,(me - k + n) % n,&got,1);
+    }
+
+    template <typename T>
+    T max_all(T value)
+    {
+        int n = size(), me = rank();
+        T result = value;
+        for (int k = 1; k < n; ++k)
+        {
+            T other{};
+            sendrecv((me + k) % n,&value,sizeof(T),(me - k + n) % n,&other,sizeof(T));
+            result = std::max(result,other);
+        }
+        return result;
+    }
+};
+
+#endif // TRANSPORT_HPP